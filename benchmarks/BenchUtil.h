@@ -0,0 +1,78 @@
+//
+//  BenchUtil.h
+//  ciSpacebrew benchmarks
+//
+//  Tiny timing + allocation counting harness shared by the benchmarks. Include it from
+//  exactly one translation unit per executable, it replaces global operator new/delete
+//  (scalar and array forms).
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+namespace bench {
+
+    static size_t sAllocations = 0;
+
+    struct Result {
+        double  nsPerOp;
+        double  allocsPerOp;
+        double  opsPerSec;
+    };
+
+    /**
+     * @brief Run fn() iterations times (after a short warm up) and report ns/op, allocations/op
+     * and throughput. bytesPerOp is optional and adds a MB/s column.
+     */
+    template<typename Fn>
+    Result run( const char * label, size_t iterations, Fn fn, size_t bytesPerOp = 0 ){
+        for ( size_t i = 0; i < iterations / 10 + 1; i++ ) fn();
+
+        size_t allocsBefore = sAllocations;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for ( size_t i = 0; i < iterations; i++ ) fn();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        Result r;
+        double ns       = (double) std::chrono::duration_cast<std::chrono::nanoseconds>( end - start ).count();
+        r.nsPerOp       = ns / iterations;
+        r.allocsPerOp   = (double)( sAllocations - allocsBefore ) / iterations;
+        r.opsPerSec     = 1e9 / r.nsPerOp;
+
+        if ( bytesPerOp ){
+            printf( "%-48s %10.1f ns/op %8.2f allocs/op %12.0f ops/s %9.1f MB/s\n", label, r.nsPerOp, r.allocsPerOp, r.opsPerSec, bytesPerOp * r.opsPerSec / ( 1024.0 * 1024.0 ) );
+        } else {
+            printf( "%-48s %10.1f ns/op %8.2f allocs/op %12.0f ops/s\n", label, r.nsPerOp, r.allocsPerOp, r.opsPerSec );
+        }
+        return r;
+    }
+
+    // keep the optimizer from throwing away results
+    template<typename T>
+    inline void doNotOptimize( const T & value ){
+        asm volatile( "" : : "r"( &value ) : "memory" );
+    }
+}
+
+void * operator new( size_t size ){
+    bench::sAllocations++;
+    void * p = malloc( size ? size : 1 );
+    if ( !p ) throw std::bad_alloc();
+    return p;
+}
+
+// array forms too, otherwise new T[n] (and toolchains whose default new[] doesn't forward to
+// operator new) slip past the allocation counts
+void * operator new[]( size_t size ){
+    return operator new( size );
+}
+
+void operator delete( void * p ) noexcept { free( p ); }
+void operator delete( void * p, size_t ) noexcept { free( p ); }
+void operator delete[]( void * p ) noexcept { free( p ); }
+void operator delete[]( void * p, size_t ) noexcept { free( p ); }
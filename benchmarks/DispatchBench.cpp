@@ -0,0 +1,87 @@
+//
+//  DispatchBench.cpp
+//  ciSpacebrew benchmarks
+//
+//  Emitting to 1-64 listeners through boost::signals2 against Spacebrew::Dispatcher, the two
+//  ways Connection hands out incoming messages. The payload is passed by const reference in both.
+//  Build: c++ -std=c++11 -O2 -I../src DispatchBench.cpp -o DispatchBench
+//
+
+#include "BenchUtil.h"
+#include "ciSpacebrewDispatcher.h"
+
+#include <boost/signals2.hpp>
+#include <vector>
+
+using namespace std;
+
+// stands in for a MessageView: a few pointers and sizes
+struct Payload {
+    const char *    name;
+    size_t          nameLen;
+    const char *    value;
+    size_t          valueLen;
+};
+
+struct Counter {
+    Counter() : sum( 0 ) {}
+    void operator()( const Payload & p ){ sum += p.valueLen; }
+    size_t sum;
+};
+
+int main(){
+    const size_t listenerCounts[] = { 1, 4, 16, 64 };
+    Payload payload = { "mouseX", 6, "512", 3 };
+
+    for ( size_t i = 0; i < sizeof(listenerCounts) / sizeof(listenerCounts[0]); i++ ){
+        size_t  listeners   = listenerCounts[i];
+        size_t  N           = 4 * 1000 * 1000 / listeners + 1000;
+        char    label[ 64 ];
+
+        vector<Counter> counters( listeners );
+
+        boost::signals2::signal<void(const Payload &)> signal;
+        Spacebrew::Dispatcher<const Payload &> dispatcher;
+        for ( size_t k = 0; k < listeners; k++ ){
+            Counter * c = &counters[k];
+            signal.connect( [c]( const Payload & p ){ (*c)( p ); } );
+            dispatcher.connect( [c]( const Payload & p ){ (*c)( p ); } );
+        }
+
+        snprintf( label, sizeof(label), "emit to %2d listeners, boost::signals2", (int) listeners );
+        bench::run( label, N, [&](){
+            signal( payload );
+        } );
+
+        snprintf( label, sizeof(label), "emit to %2d listeners, Dispatcher", (int) listeners );
+        bench::run( label, N, [&](){
+            dispatcher( payload );
+        } );
+
+        bench::doNotOptimize( counters );
+    }
+
+    // a listener that disconnects and reconnects itself every time, the worst case for the
+    // deferred removal path
+    {
+        const size_t N = 1000 * 1000;
+        Spacebrew::Dispatcher<const Payload &> dispatcher;
+        Counter counter;
+        for ( size_t k = 0; k < 7; k++ ){
+            dispatcher.connect( [&]( const Payload & p ){ counter( p ); } );
+        }
+        Spacebrew::DelegateHandle self;
+        std::function<void(const Payload &)> churn = [&]( const Payload & p ){
+            counter( p );
+            self.disconnect();
+            self = dispatcher.connect( churn );
+        };
+        self = dispatcher.connect( churn );
+
+        bench::run( "emit to 8, one reconnecting itself, Dispatcher", N, [&](){
+            dispatcher( payload );
+        } );
+        bench::doNotOptimize( counter );
+    }
+    return 0;
+}
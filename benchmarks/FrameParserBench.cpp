@@ -0,0 +1,115 @@
+//
+//  FrameParserBench.cpp
+//  ciSpacebrew benchmarks
+//
+//  Throughput of parseMessageFrame on frames recorded from a Spacebrew server session.
+//  Build: c++ -std=c++11 -O2 -I../src FrameParserBench.cpp ../src/ciSpacebrewJson.cpp -o FrameParserBench
+//  Define SPACEBREW_BENCH_JSONTREE (and build against Cinder) to compare with the JsonTree path.
+//
+
+#include "BenchUtil.h"
+#include "ciSpacebrewJson.h"
+
+#ifdef SPACEBREW_BENCH_JSONTREE
+#include "cinder/Json.h"
+#endif
+
+#include <vector>
+#include <sstream>
+#include <locale>
+
+using namespace std;
+
+static const char * kRecordedFrames[] = {
+    "{\"message\":{\"clientName\":\"button\",\"name\":\"buttonPress\",\"type\":\"boolean\",\"value\":\"true\",\"remoteAddress\":\"192.168.1.12\"}}",
+    "{\"message\":{\"clientName\":\"slider\",\"name\":\"backgroundColor\",\"type\":\"range\",\"value\":\"512\",\"remoteAddress\":\"192.168.1.14\"}}",
+    "{\"message\":{\"clientName\":\"slider\",\"name\":\"backgroundColor\",\"type\":\"range\",\"value\":1023}}",
+    "{\"message\":{\"clientName\":\"chat\",\"name\":\"text\",\"type\":\"string\",\"value\":\"hello there! this is a longer chat line from the browser\"}}",
+    "{\"message\": {\"clientName\": \"kinect\", \"name\": \"hand\", \"type\": \"point2d\", \"value\": [0.25, 0.75]}}",
+    "{\"message\":{\"clientName\":\"cinder-button-example\",\"name\":\"drawIcon\",\"type\":\"boolean\",\"value\":\"false\"}}",
+};
+
+int main(){
+    const size_t numFrames = sizeof( kRecordedFrames ) / sizeof( kRecordedFrames[0] );
+    
+    vector<string>  frames;
+    size_t          totalBytes = 0;
+    for ( size_t i = 0; i < numFrames; i++ ){
+        frames.push_back( kRecordedFrames[i] );
+        totalBytes += frames.back().size();
+    }
+    
+    // every recorded frame should take the fast path
+    for ( size_t i = 0; i < numFrames; i++ ){
+        string copy = frames[i];
+        Spacebrew::MessageFrame frame;
+        if ( !Spacebrew::parseMessageFrame( &copy[0], copy.size(), frame ) ){
+            printf( "fast path rejected: %s\n", frames[i].c_str() );
+            return 1;
+        }
+    }
+    
+    const size_t N = 500000;
+    size_t idx = 0;
+    string scratch, name, type, value;
+    
+    bench::run( "parseMessageFrame (views only)", N, [&](){
+        scratch.assign( frames[ idx++ % numFrames ] );
+        Spacebrew::MessageFrame frame;
+        Spacebrew::parseMessageFrame( &scratch[0], scratch.size(), frame );
+        bench::doNotOptimize( frame );
+    }, totalBytes / numFrames );
+    
+    bench::run( "parseMessageFrame + copy to Message fields", N, [&](){
+        scratch.assign( frames[ idx++ % numFrames ] );
+        Spacebrew::MessageFrame frame;
+        if ( Spacebrew::parseMessageFrame( &scratch[0], scratch.size(), frame ) ){
+            name.assign( frame.name.data, frame.name.size );
+            type.assign( frame.type.data, frame.type.size );
+            value.assign( frame.value.data, frame.value.size );
+        }
+        bench::doNotOptimize( value );
+    }, totalBytes / numFrames );
+    
+    // float array values (TYPE_FLOAT_ARRAY), as JsonWriter::floatArray writes them
+    string skeleton = "[";
+    for ( int i = 0; i < 75; i++ ){
+        char num[ 32 ];
+        if ( i ) skeleton += ",";
+        skeleton.append( num, Spacebrew::JsonWriter::formatFloat( ( i % 13 ) * 37.219f - 200.5f + i * 0.001f, num ) );
+    }
+    skeleton += "]";
+    vector<float> floats;
+    
+    printf( "-- float array value, 75 elements --\n" );
+    bench::run( "istringstream", N / 50, [&](){
+        istringstream ss( skeleton );
+        ss.imbue( std::locale::classic() );
+        floats.clear();
+        char c;
+        float f;
+        ss >> c;
+        while ( ss >> f ){
+            floats.push_back( f );
+            ss >> c;
+        }
+        bench::doNotOptimize( floats );
+    }, skeleton.size() );
+    
+    bench::run( "parseFloatArray", N / 50, [&](){
+        Spacebrew::parseFloatArray( skeleton, floats );
+        bench::doNotOptimize( floats );
+    }, skeleton.size() );
+    
+#ifdef SPACEBREW_BENCH_JSONTREE
+    bench::run( "JsonTree", N / 10, [&](){
+        ci::JsonTree j( frames[ idx++ % numFrames ] );
+        name = j.getChild("message").getChild("name").getValue();
+        type = j.getChild("message").getChild("type").getValue();
+        value = j.getChild("message").getChild("value").getValue();
+        bench::doNotOptimize( value );
+    }, totalBytes / numFrames );
+#endif
+    
+    return 0;
+}
@@ -0,0 +1,294 @@
+//
+//  JsonTests.cpp
+//  ciSpacebrew benchmarks
+//
+//  Behaviour checks for the wire format: what JsonWriter writes, read back with the frame and
+//  number parsers. Cinder-free, so it always builds and runs under ctest.
+//  Build: c++ -std=c++11 -O2 -I../src JsonTests.cpp ../src/ciSpacebrewJson.cpp -o JsonTests
+//
+
+#include "BenchUtil.h"
+#include "TestUtil.h"
+#include "ciSpacebrewJson.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace std;
+using namespace Spacebrew;
+
+namespace {
+
+    // parse a copy of json, so the caller's string stays as written
+    bool parse( const string & json, string & buffer, MessageFrame & frame ){
+        buffer = json;
+        return parseMessageFrame( &buffer[0], buffer.size(), frame );
+    }
+
+    string messageJson( const string & clientName, const string & name, const string & type, const string & value ){
+        string      out;
+        JsonWriter  writer( out );
+        writer.message( clientName, name, type, value );
+        return out;
+    }
+
+    //--------------------------------------------------------------
+    void testMessageRoundTrip(){
+        struct Case { const char * type; string value; bool bQuoted; };
+        const Case cases[] = {
+            { "string",     "hello",        true },
+            { "string",     "",             true },
+            { "boolean",    "true",         true },
+            { "range",      "1023",         false },
+            { "range",      "-17",          false },
+            { "point2d",    "[0.25,0.75]",  false },
+            { "custom",     "null",         false },
+        };
+        for ( const Case & c : cases ){
+            string          buffer;
+            MessageFrame    frame;
+            string          json = messageJson( "client", "name", c.type, c.value );
+            if ( !CHECK( parse( json, buffer, frame ) ) ){
+                printf( "    frame %s\n", json.c_str() );
+                continue;
+            }
+            CHECK_EQUAL( frame.clientName.str(), "client" );
+            CHECK_EQUAL( frame.name.str(), "name" );
+            CHECK_EQUAL( frame.type.str(), c.type );
+            CHECK_EQUAL( frame.value.str(), c.value );
+            CHECK( frame.bValueQuoted == c.bQuoted );
+        }
+    }
+
+    //--------------------------------------------------------------
+    void testIntegers(){
+        string      out;
+        JsonWriter  writer( out );
+        const int64_t values[] = { 0, 1, -1, 9, 10, 99, 100, 101, 1023, -1024, 2147483647, -2147483647 - 1,
+                                   std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min() };
+        for ( int64_t v : values ){
+            writer.reset();
+            writer.integer( v );
+            char expected[ 32 ];
+            snprintf( expected, sizeof(expected), "%lld", (long long) v );
+            CHECK_EQUAL( out, expected );
+        }
+    }
+
+    //--------------------------------------------------------------
+    void testMalformedFrames(){
+        const char * frames[] = {
+            "",
+            "{}",
+            "{\"message\":{}}",
+            "{\"message\":{,\"name\":\"n\",\"value\":1}}",                 // leading comma
+            "{\"message\":{\"name\":\"n\",,\"value\":1}}",                  // double comma
+            "{\"message\":{\"name\":\"n\" \"value\":1}}",                   // missing comma
+            "{\"message\":{\"name\":\"n\",\"value\":1,}}",                  // trailing comma
+            "{\"message\":{\"name\":\"n\",\"value\":hello}}",               // bare word
+            "{\"message\":{\"name\":\"n\",\"value\":tru}}",
+            "{\"message\":{\"name\":\"n\",\"value\":0123}}",                // leading zero
+            "{\"message\":{\"name\":\"n\",\"value\":1.}}",
+            "{\"message\":{\"name\":\"n\",\"value\":.5}}",
+            "{\"message\":{\"name\":\"n\",\"value\":1e}}",
+            "{\"message\":{\"name\":\"n\",\"value\":+1}}",
+            "{\"message\":{\"name\":\"n\",\"value\":[1,]}}",
+            "{\"message\":{\"name\":\"n\",\"value\":[1 2]}}",
+            "{\"message\":{\"name\":\"n\",\"value\":[1,2}}",
+            "{\"message\":{\"name\":\"n\",\"value\":\"open}}",              // unterminated string
+            "{\"message\":{\"name\":\"n\"}}",                               // no value
+            "{\"message\":{\"value\":1}}",                                  // no name
+            "{\"message\":{\"name\":\"n\",\"value\":1}} x",                 // trailing garbage
+            "{\"message\":{\"name\":\"n\",\"value\":1}",                    // unclosed envelope
+            "{\"config\":{\"name\":\"n\"}}",                                // not a message frame
+            "{\"message\":{\"name\":\"n\",\"value\":{\"x\":1}}}",           // objects go to JsonTree
+            "{\"message\":{\"name\":\"n\\u0041\",\"value\":1}}x",
+        };
+        for ( const char * json : frames ){
+            string          buffer;
+            MessageFrame    frame;
+            if ( !CHECK( !parse( json, buffer, frame ) ) ){
+                printf( "    accepted %s\n", json );
+            }
+            // rejected frames are left as received so JsonTree can have a go
+            CHECK( buffer == json );
+        }
+    }
+
+    //--------------------------------------------------------------
+    void testParseNumber(){
+        struct Case { const char * text; double value; };
+        const Case good[] = {
+            { "0", 0 }, { "-0", -0.0 }, { "7", 7 }, { "-12", -12 }, { "0.5", 0.5 }, { "-0.25", -0.25 },
+            { "1e3", 1000 }, { "1E-2", 0.01 }, { "2.5e+2", 250 }, { " 42 ", 42 }, { "1023", 1023 },
+            { "123456789012", 123456789012.0 }, { "0.1", 0.1 },
+        };
+        for ( const Case & c : good ){
+            double d = -1;
+            if ( !CHECK( parseNumber( StringRef( c.text, strlen( c.text ) ), d ) && d == c.value ) ){
+                printf( "    \"%s\" -> %.17g\n", c.text, d );
+            }
+        }
+
+        const char * bad[] = { "", " ", "-", "01", "-01", "1.", ".5", "1e", "1e+", "+1", "0x10", "1 2", "nan", "inf", "1,5", "--1", "true" };
+        for ( const char * text : bad ){
+            double d;
+            if ( !CHECK( !parseNumber( StringRef( text, strlen( text ) ), d ) ) ){
+                printf( "    accepted \"%s\"\n", text );
+            }
+        }
+    }
+
+    //--------------------------------------------------------------
+    bool sameFloat( float a, float b ){
+        return memcmp( &a, &b, sizeof(float) ) == 0;
+    }
+
+    void testFloatRoundTrip(){
+        char buf[ 32 ];
+
+        // a spread of bit patterns across every exponent, both signs
+        size_t numFailed = 0;
+        for ( uint64_t bits = 0; bits <= 0xFFFFFFFFull; bits += 65521 ){
+            uint32_t    u = (uint32_t) bits;
+            float       f;
+            memcpy( &f, &u, sizeof(f) );
+            if ( f != f || std::isinf( f ) ) continue;
+
+            size_t  len = JsonWriter::formatFloat( f, buf );
+            double  d;
+            if ( !parseNumber( StringRef( buf, len ), d ) || !sameFloat( (float) d, f ) ){
+                if ( numFailed++ < 5 ) printf( "    %.9g -> \"%.*s\"\n", f, (int) len, buf );
+            }
+        }
+        CHECK( numFailed == 0 );
+
+        // shortest form for the values people actually type
+        struct Case { float value; const char * text; };
+        const Case cases[] = { { 0.f, "0" }, { 1.f, "1" }, { -2.f, "-2" }, { 0.1f, "0.1" }, { 0.5f, "0.5" }, { 100.f, "100" }, { 3.14159f, "3.14159" } };
+        for ( const Case & c : cases ){
+            CHECK_EQUAL( string( buf, JsonWriter::formatFloat( c.value, buf ) ), c.text );
+        }
+
+        // no JSON for NaN / infinity
+        CHECK_EQUAL( string( buf, JsonWriter::formatFloat( std::numeric_limits<float>::quiet_NaN(), buf ) ), "null" );
+        CHECK_EQUAL( string( buf, JsonWriter::formatFloat( std::numeric_limits<float>::infinity(), buf ) ), "null" );
+
+        // extremes
+        const float extremes[] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::min(), std::numeric_limits<float>::denorm_min(), -std::numeric_limits<float>::max() };
+        for ( float f : extremes ){
+            double d;
+            CHECK( parseNumber( StringRef( buf, JsonWriter::formatFloat( f, buf ) ), d ) && sameFloat( (float) d, f ) );
+        }
+    }
+
+    //--------------------------------------------------------------
+    void testFloatArray(){
+        vector<float> values;
+        for ( int i = 0; i < 100; i++ ) values.push_back( (float) std::sin( i * 0.37 ) * std::pow( 10.f, (float)( i % 13 - 6 ) ) );
+        values.push_back( std::numeric_limits<float>::quiet_NaN() );
+
+        string      out;
+        JsonWriter  writer( out );
+        writer.floatArray( values.data(), values.size() );
+
+        vector<float> parsed;
+        CHECK( parseFloatArray( StringRef( out ), parsed ) );
+        CHECK( parsed.size() == values.size() );
+        size_t n = std::min( parsed.size(), values.size() );
+        for ( size_t i = 0; i + 1 < n; i++ ){
+            if ( !CHECK( sameFloat( parsed[i], values[i] ) ) ) break;
+        }
+        CHECK( n && parsed[ n - 1 ] != parsed[ n - 1 ] );
+
+        // and the array goes through a frame untouched
+        string          buffer;
+        MessageFrame    frame;
+        CHECK( parse( messageJson( "c", "n", "floatArray", out ), buffer, frame ) );
+        CHECK_EQUAL( frame.value.str(), out );
+
+        CHECK( parseFloatArray( StringRef( string( " [ ] " ) ), parsed ) && parsed.empty() );
+        CHECK( parseFloatArray( StringRef( string( "[ 1 , -2.5e1 ]" ) ), parsed ) && parsed.size() == 2 && parsed[1] == -25.f );
+
+        const char * bad[] = { "", "[", "[1,]", "[,1]", "[1 2]", "[\"a\"]", "[[1]]", "[1]x", "[1,2] ]", "[ ] x", "1" };
+        for ( const char * text : bad ){
+            parsed.assign( 3, 1.f );
+            if ( !CHECK( !parseFloatArray( StringRef( text, strlen( text ) ), parsed ) && parsed.empty() ) ){
+                printf( "    accepted \"%s\"\n", text );
+            }
+        }
+    }
+
+    //--------------------------------------------------------------
+    void testEscaping(){
+        string out;
+        JsonWriter writer( out );
+
+        writer.quoted( string( "a\"b\\c\nd\te\r\b\f" ) );
+        CHECK_EQUAL( out, "\"a\\\"b\\\\c\\nd\\te\\r\\b\\f\"" );
+
+        // other control characters as \u00XX, '/' and UTF-8 pass through untouched
+        writer.reset();
+        writer.quoted( string( "\x01\x1f/\xc3\xa9" ) );
+        CHECK_EQUAL( out, "\"\\u0001\\u001f/\xc3\xa9\"" );
+
+        // every byte value survives writer -> parser, in each field
+        string all;
+        for ( int c = 1; c < 256; c++ ) all.push_back( (char) c );
+        string          buffer;
+        MessageFrame    frame;
+        CHECK( parse( messageJson( all, "n" + all, "string", all + all ), buffer, frame ) );
+        CHECK( frame.clientName.str() == all );
+        CHECK( frame.name.str() == "n" + all );
+        CHECK( frame.value.str() == all + all );
+
+        // long strings take the word-at-a-time scan, put escapes on either side of each boundary
+        for ( size_t at = 0; at < 40; at++ ){
+            string s( 40, 'x' );
+            s[ at ] = '"';
+            CHECK( parse( messageJson( "c", "n", "string", s ), buffer, frame ) && frame.value.str() == s );
+        }
+    }
+
+    //--------------------------------------------------------------
+    void testUnescaping(){
+        string          buffer;
+        MessageFrame    frame;
+
+        // what browsers send: escaped '/', \u escapes and surrogate pairs
+        CHECK( parse( "{\"message\":{\"clientName\":\"web\",\"name\":\"t\",\"type\":\"string\",\"value\":\"a\\/b \\u00e9 \\u20ac \\ud83d\\ude00\"}}", buffer, frame ) );
+        CHECK_EQUAL( frame.value.str(), "a/b \xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80" );
+
+        // lone surrogates become U+FFFD rather than invalid UTF-8
+        CHECK( parse( "{\"message\":{\"name\":\"t\",\"type\":\"string\",\"value\":\"\\ud83d!\\ude00\"}}", buffer, frame ) );
+        CHECK_EQUAL( frame.value.str(), "\xef\xbf\xbd!\xef\xbf\xbd" );
+
+        // whitespace between tokens and unknown members are fine
+        CHECK( parse( " { \"message\" : { \"clientName\" : \"c\" , \"name\" : \"n\" , \"type\" : \"range\" , \"value\" : 5 , \"remoteAddress\" : \"10.0.0.1\" } } ", buffer, frame ) );
+        CHECK_EQUAL( frame.value.str(), "5" );
+        CHECK( !frame.bValueQuoted );
+
+        // the in-place unescape doesn't allocate
+        string json = messageJson( "c\n", "n\t", "string", "line one\nline \"two\"\n" );
+        buffer = json;
+        size_t allocs = bench::sAllocations;
+        bool bParsed = parseMessageFrame( &buffer[0], buffer.size(), frame );
+        CHECK( bParsed && bench::sAllocations == allocs );
+        CHECK_EQUAL( frame.value.str(), "line one\nline \"two\"\n" );
+    }
+}
+
+int main(){
+    testMessageRoundTrip();
+    testIntegers();
+    testMalformedFrames();
+    testParseNumber();
+    testFloatRoundTrip();
+    testFloatArray();
+    testEscaping();
+    testUnescaping();
+    return test::finish( "JsonTests" );
+}
@@ -0,0 +1,134 @@
+//
+//  JsonWriterBench.cpp
+//  ciSpacebrew benchmarks
+//
+//  Compares the old string-concatenation Message::getJSON against JsonWriter, and
+//  stringstream float formatting against JsonWriter::floatArray.
+//  Build: c++ -std=c++11 -O2 -I../src JsonWriterBench.cpp ../src/ciSpacebrewJson.cpp -o JsonWriterBench
+//
+
+#include "BenchUtil.h"
+#include "ciSpacebrewJson.h"
+
+#include <sstream>
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+// the pre-JsonWriter Message::getJSON, kept here as the baseline
+static string concatGetJSON( const string & configName, const string & name, const string & type, const string & value ){
+    if ( type == "string" || type == "boolean" ){
+        return "{\"message\":{\"clientName\":\"" + configName +"\",\"name\":\"" + name + "\",\"type\":\"" + type + "\",\"value\":\"" + value +"\"}}";
+    } else {
+        return "{\"message\":{\"clientName\":\"" + configName +"\",\"name\":\"" + name + "\",\"type\":\"" + type + "\",\"value\":" + value +"}}";
+    }
+}
+
+static string streamToString( int v ){
+    stringstream ss;
+    ss << v;
+    return ss.str();
+}
+
+int main(){
+    const size_t    N           = 2000000;
+    const string    clientName  = "cinder-button-example";
+    const string    name        = "mouseX";
+    const string    range       = "range";
+    const string    str         = "string";
+    const string    greeting    = "hello there, this is a slightly longer greeting";
+
+    int counter = 0;
+
+    printf( "-- range frame (sendRange) --\n" );
+    bench::run( "concat + toString", N, [&](){
+        string frame = concatGetJSON( clientName, name, range, streamToString( counter++ & 1023 ) );
+        bench::doNotOptimize( frame );
+    });
+
+    string buffer;
+    bench::run( "JsonWriter + formatInt", N, [&](){
+        char num[ 24 ];
+        size_t len = Spacebrew::JsonWriter::formatInt( counter++ & 1023, num );
+        Spacebrew::JsonWriter writer( buffer );
+        writer.reset();
+        writer.message( clientName, name, range, num, len );
+        bench::doNotOptimize( buffer );
+    });
+
+    printf( "-- string frame (sendString) --\n" );
+    bench::run( "concat", N, [&](){
+        string frame = concatGetJSON( clientName, name, str, greeting );
+        bench::doNotOptimize( frame );
+    });
+
+    bench::run( "JsonWriter", N, [&](){
+        Spacebrew::JsonWriter writer( buffer );
+        writer.reset();
+        writer.message( clientName, name, str, greeting );
+        bench::doNotOptimize( buffer );
+    });
+
+    // a 25 joint skeleton, xyz per joint
+    vector<float> skeleton( 75 );
+    for ( size_t i = 0; i < skeleton.size(); i++ ){
+        skeleton[i] = sinf( i * 0.37f ) * ( 1 + ( i % 7 ) * 113.3f );
+    }
+    const size_t M = N / 100;
+    
+    printf( "-- float array, %d elements (per element below = ns/op / %d) --\n", (int) skeleton.size(), (int) skeleton.size() );
+    bench::run( "stringstream", M, [&](){
+        stringstream ss;
+        ss << "[";
+        for ( size_t i = 0; i < skeleton.size(); i++ ){
+            if ( i ) ss << ",";
+            ss << skeleton[i];
+        }
+        ss << "]";
+        string value = ss.str();
+        bench::doNotOptimize( value );
+    });
+    
+    bench::run( "stringstream, round-trip precision (9)", M, [&](){
+        stringstream ss;
+        ss.precision( 9 );
+        ss << "[";
+        for ( size_t i = 0; i < skeleton.size(); i++ ){
+            if ( i ) ss << ",";
+            ss << skeleton[i];
+        }
+        ss << "]";
+        string value = ss.str();
+        bench::doNotOptimize( value );
+    });
+    
+    bench::run( "JsonWriter::floatArray (shortest round-trip)", M, [&](){
+        Spacebrew::JsonWriter writer( buffer );
+        writer.reset();
+        writer.floatArray( &skeleton[0], skeleton.size() );
+        bench::doNotOptimize( buffer );
+    });
+    
+    // sanity: every element must read back exactly
+    {
+        Spacebrew::JsonWriter writer( buffer );
+        writer.reset();
+        writer.floatArray( &skeleton[0], skeleton.size() );
+        vector<float> back;
+        if ( !Spacebrew::parseFloatArray( buffer, back ) || back != skeleton ){
+            printf( "FLOAT ROUND TRIP FAILED: %s\n", buffer.c_str() );
+            return 1;
+        }
+    }
+
+    // sanity: both paths must produce identical frames
+    Spacebrew::JsonWriter writer( buffer );
+    writer.reset();
+    writer.message( clientName, name, range, "512", 3 );
+    if ( buffer != concatGetJSON( clientName, name, range, "512" ) ){
+        printf( "MISMATCH: %s\n", buffer.c_str() );
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+//
+//  LoopbackBench.cpp
+//  ciSpacebrew benchmarks
+//
+//  End-to-end send -> receive latency and throughput between two real Connections,
+//  routed through an in-process Spacebrew::Router over loopback WebSocket.
+//
+
+#include "ciSpacebrew.h"
+#include "ciSpacebrewRouter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+static int64_t nowNanos(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// keep updating both ends until done() or the timeout passes
+template<typename Fn>
+static bool pump( Spacebrew::Connection & a, Spacebrew::Connection & b, Fn done, int timeoutMillis = 5000 ){
+    int64_t deadline = nowNanos() + (int64_t) timeoutMillis * 1000000;
+    while ( !done() ){
+        if ( nowNanos() > deadline ) return false;
+        a.update();
+        b.update();
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+int main( int argc, char * argv[] ){
+    const uint16_t  port        = 9876;
+    const string    host        = "ws://localhost:" + to_string( port );
+    const int       numPings    = 5000;
+    const int       numBurst    = 100000;
+    
+    Spacebrew::Router router;
+    if ( !router.listen( port ) ) return 1;
+    router.start();
+    router.addRoute( "bench-sender", "out", "bench-receiver", "in" );
+    
+    Spacebrew::Connection sender, receiver;
+    sender.setThreaded();
+    receiver.setThreaded();
+    sender.setIdleSleep( 0 );
+    receiver.setIdleSleep( 0 );
+    
+    Spacebrew::PublisherRef out = sender.addPublish( "out", Spacebrew::TYPE_STRING );
+    receiver.addSubscribe( "in", Spacebrew::TYPE_STRING );
+    
+    vector<int64_t> latencies;
+    latencies.reserve( numPings );
+    int received = 0;
+    
+    receiver.onMessage( "in", [&]( Spacebrew::Message m ){
+        received++;
+        if ( (int) latencies.size() < numPings && m.valueString() != "burst" ){
+            latencies.push_back( nowNanos() - std::stoll( m.valueString() ) );
+        }
+    });
+    
+    sender.connect( host, "bench-sender", "" );
+    receiver.connect( host, "bench-receiver", "" );
+    if ( !pump( sender, receiver, [&](){ return sender.isConnected() && receiver.isConnected() && router.getClientNames().size() == 2; } ) ){
+        printf( "couldn't connect to the loopback router\n" );
+        return 1;
+    }
+    
+    // latency: one message in flight at a time
+    for ( int i = 0; i < numPings; i++ ){
+        out->sendString( to_string( nowNanos() ) );
+        int target = received + 1;
+        if ( !pump( sender, receiver, [&](){ return received >= target; } ) ){
+            printf( "timed out waiting for ping %d\n", i );
+            return 1;
+        }
+    }
+    
+    std::sort( latencies.begin(), latencies.end() );
+    printf( "send -> receive latency over %d messages (us): p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", numPings,
+        latencies[ latencies.size() / 2 ] / 1000.0,
+        latencies[ latencies.size() * 9 / 10 ] / 1000.0,
+        latencies[ latencies.size() * 99 / 100 ] / 1000.0,
+        latencies.back() / 1000.0 );
+    
+    // throughput: send a burst and wait for all of it
+    int target  = received + numBurst;
+    int64_t start = nowNanos();
+    for ( int i = 0; i < numBurst; i++ ){
+        out->sendString( "burst" );
+        if ( ( i & 255 ) == 0 ){
+            sender.update();
+            receiver.update();
+        }
+    }
+    bool bDone = pump( sender, receiver, [&](){ return received >= target; }, 30000 );
+    double seconds = ( nowNanos() - start ) / 1e9;
+    
+    printf( "burst of %d messages: %s in %.3f s, %.0f msgs/s (%zu dropped on send)\n", numBurst,
+        bDone ? "delivered" : "INCOMPLETE", seconds, ( received - ( target - numBurst ) ) / seconds, sender.getNumDroppedWrites() );
+    
+    router.stop();
+    return bDone ? 0 : 1;
+}
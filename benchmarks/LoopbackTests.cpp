@@ -0,0 +1,517 @@
+//
+//  LoopbackTests.cpp
+//  ciSpacebrew benchmarks
+//
+//  Behaviour checks for Connection against an in-process Spacebrew::Router over loopback
+//  WebSocket: what one Connection sends is what the other one gets. Every test uses its own
+//  client names, so they all share one Router.
+//
+
+#include "ciSpacebrew.h"
+#include "ciSpacebrewRouter.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <thread>
+
+using namespace std;
+using namespace Spacebrew;
+
+namespace {
+
+    const uint16_t  kPort   = 9877;
+    const string    kHost   = "ws://localhost:" + to_string( kPort );
+
+    Router router;
+
+    int64_t nowMillis(){
+        return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    // keep updating the connections until done() or the timeout passes
+    template<typename Fn>
+    bool pump( const vector<Connection *> & connections, Fn done, int timeoutMillis = 5000 ){
+        int64_t deadline = nowMillis() + timeoutMillis;
+        while ( !done() ){
+            if ( nowMillis() > deadline ) return false;
+            for ( size_t i = 0; i < connections.size(); i++ ){
+                connections[i]->update();
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // pump for a while regardless, to give frames that shouldn't arrive the chance to
+    void settle( const vector<Connection *> & connections, int millis = 100 ){
+        pump( connections, [](){ return false; }, millis );
+    }
+
+    bool isConfigured( const string & name ){
+        vector<string> names = router.getClientNames();
+        return std::find( names.begin(), names.end(), name ) != names.end();
+    }
+
+    bool connectAll( const vector<Connection *> & connections, const vector<string> & names ){
+        for ( size_t i = 0; i < connections.size(); i++ ){
+            connections[i]->connect( kHost, names[i], "" );
+        }
+        return pump( connections, [&](){
+            for ( size_t i = 0; i < connections.size(); i++ ){
+                if ( !connections[i]->isConnected() || !isConfigured( names[i] ) ) return false;
+            }
+            return true;
+        });
+    }
+
+    //--------------------------------------------------------------
+    void testValues(){
+        Connection sender, receiver;
+        PublisherRef text   = sender.addPublish( "text", TYPE_STRING );
+        PublisherRef range  = sender.addPublish( "range", TYPE_RANGE );
+        PublisherRef flag   = sender.addPublish( "flag", TYPE_BOOLEAN );
+        receiver.addSubscribe( "text", TYPE_STRING );
+        receiver.addSubscribe( "range", TYPE_RANGE );
+        receiver.addSubscribe( "flag", TYPE_BOOLEAN );
+        const char * names[] = { "text", "range", "flag" };
+        for ( const char * name : names ){
+            router.addRoute( "values-sender", name, "values-receiver", name );
+        }
+
+        vector<string>  texts;
+        vector<int>     ranges;
+        vector<bool>    flags;
+        receiver.onMessage( "text", [&]( Message m ){ texts.push_back( m.valueString() ); } );
+        receiver.onMessage( "range", [&]( Message m ){ ranges.push_back( m.valueRange() ); } );
+        receiver.onMessage( "flag", [&]( Message m ){ flags.push_back( m.valueBoolean() ); } );
+
+        if ( !CHECK( connectAll( { &sender, &receiver }, { "values-sender", "values-receiver" } ) ) ) return;
+
+        text->sendString( "hello" );
+        text->sendString( "" );
+        sender.sendString( "text", "by name" );
+        sender.send( Message( "text", TYPE_STRING, "as a Message" ) );
+        range->sendRange( 512 );
+        range->sendRange( 1023 );
+        sender.sendRange( "range", 0 );
+        flag->sendBoolean( true );
+        flag->sendBoolean( false );
+        sender.sendBoolean( "flag", true );
+
+        CHECK( pump( { &sender, &receiver }, [&](){ return texts.size() == 4 && ranges.size() == 3 && flags.size() == 3; } ) );
+
+        // each exactly once
+        settle( { &sender, &receiver } );
+        CHECK( texts == vector<string>( { "hello", "", "by name", "as a Message" } ) );
+        CHECK( ranges == vector<int>( { 512, 1023, 0 } ) );
+        CHECK( flags == vector<bool>( { true, false, true } ) );
+
+        // out of range values go out as sent, the receiving end clamps them to 0..1023
+        range->sendRange( -5 );
+        range->sendRange( 2000 );
+        CHECK( pump( { &sender, &receiver }, [&](){ return ranges.size() == 5; } ) );
+        CHECK( ranges == vector<int>( { 512, 1023, 0, 0, 1023 } ) );
+    }
+
+    //--------------------------------------------------------------
+    void testNestedValues(){
+        Connection sender, receiver;
+        receiver.addSubscribe( "point", "point2d" );
+        receiver.addSubscribe( "tags", "tags" );
+        router.addRoute( "nested-sender", "point", "nested-receiver", "point" );
+        router.addRoute( "nested-sender", "tags", "nested-receiver", "tags" );
+        sender.addPublish( "point", "point2d" );
+        sender.addPublish( "tags", "tags" );
+
+        vector<string> points, tags;
+        receiver.onMessage( "point", [&]( Message m ){ points.push_back( m.value ); } );
+        receiver.onMessage( "tags", [&]( Message m ){ tags.push_back( m.value ); } );
+        if ( !CHECK( connectAll( { &sender, &receiver }, { "nested-sender", "nested-receiver" } ) ) ) return;
+
+        // objects and arrays of strings skip the fast path on both ends and come through JsonTree,
+        // which hands them over serialized (spacing may differ, so compare parsed)
+        sender.send( "point", "point2d", "{\"x\":0.25,\"y\":-3}" );
+        sender.send( "tags", "tags", "[\"a\",\"b \\\"c\\\"\"]" );
+        CHECK( pump( { &sender, &receiver }, [&](){ return points.size() == 1 && tags.size() == 1; } ) );
+        if ( points.size() == 1 ){
+            try {
+                ci::JsonTree point( points[0] );
+                CHECK( point.getNodeType() == ci::JsonTree::NODE_OBJECT );
+                CHECK_EQUAL( point.getChild( "x" ).getValue(), "0.25" );
+                CHECK_EQUAL( point.getChild( "y" ).getValue(), "-3" );
+            } catch ( ci::JsonTree::Exception & ){
+                CHECK( !"object value arrived as JSON" );
+                printf( "    got \"%s\"\n", points[0].c_str() );
+            }
+        }
+        if ( tags.size() == 1 ){
+            try {
+                ci::JsonTree list( tags[0] );
+                CHECK( list.getNodeType() == ci::JsonTree::NODE_ARRAY );
+                vector<string> values;
+                for ( ci::JsonTree::ConstIter it = list.begin(); it != list.end(); ++it ) values.push_back( it->getValue() );
+                CHECK( values == vector<string>( { "a", "b \"c\"" } ) );
+            } catch ( ci::JsonTree::Exception & ){
+                CHECK( !"array value arrived as JSON" );
+                printf( "    got \"%s\"\n", tags[0].c_str() );
+            }
+        }
+    }
+
+    //--------------------------------------------------------------
+    void testRateLimit(){
+        Connection sender, receiver;
+        PublisherRef dropped = sender.addPublish( "drop", TYPE_RANGE, "", PublishOptions().rateLimit( 1, 3, PublishOptions::RATE_DROP ) );
+        PublisherRef delayed = sender.addPublish( "delay", TYPE_RANGE, "", PublishOptions().rateLimit( 50, 1, PublishOptions::RATE_DELAY ) );
+        receiver.addSubscribe( "drop", TYPE_RANGE );
+        receiver.addSubscribe( "delay", TYPE_RANGE );
+        router.addRoute( "rate-sender", "drop", "rate-receiver", "drop" );
+        router.addRoute( "rate-sender", "delay", "rate-receiver", "delay" );
+
+        vector<int> dropReceived, delayReceived;
+        receiver.onMessage( "drop", [&]( Message m ){ dropReceived.push_back( m.valueRange() ); } );
+        receiver.onMessage( "delay", [&]( Message m ){ delayReceived.push_back( m.valueRange() ); } );
+
+        if ( !CHECK( connectAll( { &sender, &receiver }, { "rate-sender", "rate-receiver" } ) ) ) return;
+
+        // RATE_DROP: the burst goes out, the rest is counted and discarded
+        for ( int i = 0; i < 10; i++ ) dropped->sendRange( i );
+        CHECK( dropped->getNumRateDropped() == 7 );
+
+        // RATE_DELAY: everything arrives in order, spaced out by the rate
+        int64_t start = nowMillis();
+        for ( int i = 0; i < 5; i++ ) delayed->sendRange( i );
+        CHECK( delayed->getNumRateDelayed() == 4 );
+        CHECK( pump( { &sender, &receiver }, [&](){ return delayReceived.size() == 5; } ) );
+        CHECK( nowMillis() - start >= 60 );
+        CHECK( delayReceived == vector<int>( { 0, 1, 2, 3, 4 } ) );
+
+        settle( { &sender, &receiver } );
+        CHECK( dropReceived == vector<int>( { 0, 1, 2 } ) );
+
+        // a RATE_DELAY queue is never shorter than one: 0 keeps just the newest delayed send
+        CHECK( PublishOptions().rateLimit( 50, 1, PublishOptions::RATE_DELAY, 0 ).maxDelayed == 1 );
+        PublishOptions unbounded;
+        unbounded.rateLimit( 50, 1, PublishOptions::RATE_DELAY ).maxDelayed = 0;
+        PublisherRef latest     = sender.addPublish( "latest", TYPE_RANGE, "", PublishOptions().rateLimit( 50, 1, PublishOptions::RATE_DELAY, 0 ) );
+        PublisherRef zeroed     = sender.addPublish( "zeroed", TYPE_RANGE, "", unbounded );
+        receiver.addSubscribe( "latest", TYPE_RANGE );
+        router.addRoute( "rate-sender", "latest", "rate-receiver", "latest" );
+        router.addRoute( "rate-sender", "zeroed", "rate-receiver", "latest" );
+        vector<int> latestReceived;
+        receiver.onMessage( "latest", [&]( Message m ){ latestReceived.push_back( m.valueRange() ); } );
+        settle( { &sender, &receiver } );
+
+        for ( int i = 0; i < 3; i++ ) latest->sendRange( i );
+        CHECK( latest->getNumRateDelayed() == 2 );
+        CHECK( latest->getNumRateDropped() == 1 );
+        CHECK( pump( { &sender, &receiver }, [&](){ return latestReceived.size() == 2; } ) );
+
+        // set on the options directly, skipping rateLimit(): still one slot, never a pop from an empty queue
+        for ( int i = 10; i < 13; i++ ) zeroed->sendRange( i );
+        CHECK( zeroed->getNumRateDropped() == 1 );
+        CHECK( pump( { &sender, &receiver }, [&](){ return latestReceived.size() == 4; } ) );
+        settle( { &sender, &receiver } );
+        CHECK( latestReceived == vector<int>( { 0, 2, 10, 12 } ) );
+    }
+
+    //--------------------------------------------------------------
+    void testFloatArrays(){
+        Connection sender, receiver;
+        PublisherRef floats = sender.addPublish( "floats", TYPE_FLOAT_ARRAY );
+        receiver.addSubscribe( "floats", TYPE_FLOAT_ARRAY );
+        router.addRoute( "floats-sender", "floats", "floats-receiver", "floats" );
+
+        vector< vector<float> > arrays;
+        receiver.onMessage( "floats", [&]( Message m ){ arrays.push_back( m.valueFloatArray() ); } );
+        if ( !CHECK( connectAll( { &sender, &receiver }, { "floats-sender", "floats-receiver" } ) ) ) return;
+
+        // bit exact through the shortest formatting
+        const float values[] = { 0.1f, -2.5e-7f, 1e30f, 3.f, 0.f, 1.f / 3.f, std::numeric_limits<float>::denorm_min() };
+        const size_t count = sizeof( values ) / sizeof( values[0] );
+        floats->sendFloatArray( values, count );
+        floats->sendFloatArray( values, 0 );
+        sender.sendFloatArray( "floats", values, 2 );
+
+        CHECK( pump( { &sender, &receiver }, [&](){ return arrays.size() == 3; } ) );
+        if ( CHECK( arrays.size() == 3 ) ){
+            CHECK( arrays[0] == vector<float>( values, values + count ) );
+            CHECK( arrays[1].empty() );
+            CHECK( arrays[2] == vector<float>( values, values + 2 ) );
+        }
+    }
+
+    //--------------------------------------------------------------
+    void testEscapedStrings(){
+        Connection sender, receiver;
+        PublisherRef text = sender.addPublish( "text \"quoted\"", TYPE_STRING );
+        receiver.addSubscribe( "in\n", TYPE_STRING );
+        router.addRoute( "escape \\ sender", "text \"quoted\"", "escape-receiver", "in\n" );
+
+        vector<string> texts;
+        receiver.onMessage( "in\n", [&]( Message m ){ texts.push_back( m.valueString() ); } );
+        if ( !CHECK( connectAll( { &sender, &receiver }, { "escape \\ sender", "escape-receiver" } ) ) ) return;
+
+        // escaped on the way out, unescaped in place by the Router and again by the receiver
+        const string tricky = "quote \" backslash \\ slash / newline \n tab \t ctrl \x01\x1f utf8 \xc3\xa9 \xf0\x9f\x98\x80";
+        string all;
+        for ( int c = 1; c < 256; c++ ) all.push_back( (char) c );
+        text->sendString( tricky );
+        text->sendString( all );
+        sender.sendString( "text \"quoted\"", "by name, \"quoted\"" );
+
+        CHECK( pump( { &sender, &receiver }, [&](){ return texts.size() == 3; } ) );
+        if ( CHECK( texts.size() == 3 ) ){
+            CHECK_EQUAL( texts[0], tricky );
+            CHECK( texts[1] == all );
+            CHECK_EQUAL( texts[2], "by name, \"quoted\"" );
+        }
+    }
+
+    //--------------------------------------------------------------
+    void testOfflineBuffer(){
+        Connection receiver, oldest, latest, none;
+        receiver.addSubscribe( "seq", TYPE_RANGE );
+        receiver.addSubscribe( "latest", TYPE_STRING );
+        receiver.addSubscribe( "none", TYPE_STRING );
+        router.addRoute( "offline-oldest", "seq", "offline-receiver", "seq" );
+        router.addRoute( "offline-latest", "a", "offline-receiver", "latest" );
+        router.addRoute( "offline-latest", "b", "offline-receiver", "latest" );
+        router.addRoute( "offline-none", "none", "offline-receiver", "none" );
+
+        vector<int>     seq;
+        vector<string>  latestReceived, noneReceived;
+        receiver.onMessage( "seq", [&]( Message m ){ seq.push_back( m.valueRange() ); } );
+        receiver.onMessage( "latest", [&]( Message m ){ latestReceived.push_back( m.valueString() ); } );
+        receiver.onMessage( "none", [&]( Message m ){ noneReceived.push_back( m.valueString() ); } );
+        if ( !CHECK( connectAll( { &receiver }, { "offline-receiver" } ) ) ) return;
+
+        // OFFLINE_DROP_OLDEST keeps the newest maxFrames
+        PublisherRef s = oldest.addPublish( "seq", TYPE_RANGE );
+        oldest.setOfflineBuffer( Connection::OFFLINE_DROP_OLDEST, 3 );
+        for ( int i = 0; i < 5; i++ ) s->sendRange( i );
+        CHECK( oldest.getNumOfflineBuffered() == 3 );
+        CHECK( oldest.getNumOfflineDropped() == 2 );
+
+        // OFFLINE_LATEST_PER_PUBLISHER keeps one frame per name
+        PublisherRef a = latest.addPublish( "a", TYPE_STRING );
+        PublisherRef b = latest.addPublish( "b", TYPE_STRING );
+        latest.setOfflineBuffer( Connection::OFFLINE_LATEST_PER_PUBLISHER );
+        a->sendString( "a1" );
+        a->sendString( "a2" );
+        b->sendString( "b1" );
+        a->sendString( "a3" );
+        CHECK( latest.getNumOfflineBuffered() == 2 );
+        CHECK( latest.getNumOfflineDropped() == 2 );
+
+        // OFFLINE_DROP (the default) buffers nothing
+        PublisherRef n = none.addPublish( "none", TYPE_STRING );
+        n->sendString( "lost" );
+        CHECK( none.getNumOfflineBuffered() == 0 );
+
+        // flushed right behind the config on connect
+        if ( !CHECK( connectAll( { &oldest, &latest, &none }, { "offline-oldest", "offline-latest", "offline-none" } ) ) ) return;
+        n->sendString( "live" );
+        CHECK( pump( { &receiver, &oldest, &latest, &none }, [&](){ return seq.size() == 3 && latestReceived.size() == 2 && noneReceived.size() == 1; } ) );
+        settle( { &receiver, &oldest, &latest, &none } );
+        CHECK( seq == vector<int>( { 2, 3, 4 } ) );
+        CHECK( latestReceived == vector<string>( { "b1", "a3" } ) );
+        CHECK( noneReceived == vector<string>( { "live" } ) );
+        CHECK( oldest.getNumOfflineBuffered() == 0 && latest.getNumOfflineBuffered() == 0 );
+    }
+
+    //--------------------------------------------------------------
+    // exposes the reconnect schedule
+    struct BackoffConnection : public Connection {
+        using Connection::nextReconnectDelay;
+        using Connection::reconnectAttempts;
+    };
+
+    void testBackoff(){
+        BackoffConnection c;
+        c.setReconnectRate( 100 );
+
+        // no jitter: doubles from the base rate up to the cap
+        c.setReconnectBackoff( 1000, 0 );
+        const int expected[] = { 100, 200, 400, 800, 1000, 1000, 1000 };
+        for ( int i = 0; i < 7; i++ ){
+            c.reconnectAttempts = i;
+            CHECK( c.nextReconnectDelay() == expected[i] );
+        }
+        c.reconnectAttempts = 1000;
+        CHECK( c.nextReconnectDelay() == 1000 );
+
+        // jitter only ever shortens the delay, by up to the given fraction
+        c.setReconnectBackoff( 1000, 0.5 );
+        for ( int i = 0; i < 7; i++ ){
+            c.reconnectAttempts = i;
+            int lo = expected[i], hi = 0;
+            for ( int j = 0; j < 200; j++ ){
+                int d = c.nextReconnectDelay();
+                lo = std::min( lo, d );
+                hi = std::max( hi, d );
+            }
+            CHECK( hi <= expected[i] && lo >= expected[i] / 2 );
+            CHECK( lo < hi );
+        }
+    }
+
+    //--------------------------------------------------------------
+    void testRecordReplay(){
+        const string path = "LoopbackTests.sbrec";
+
+        Connection sender, receiver;
+        PublisherRef out = sender.addPublish( "out", TYPE_RANGE );
+        receiver.addSubscribe( "in", TYPE_RANGE );
+        router.addRoute( "replay-sender", "out", "replay-receiver", "in" );
+
+        vector<int> sent, received;
+        receiver.onMessage( "in", [&]( Message m ){ received.push_back( m.valueRange() ); } );
+
+        Recorder recorder;
+        if ( !CHECK( recorder.open( path ) ) ) return;
+        receiver.setRecorder( &recorder );
+        if ( !CHECK( connectAll( { &sender, &receiver }, { "replay-sender", "replay-receiver" } ) ) ) return;
+
+        for ( int i = 0; i < 50; i++ ){
+            sent.push_back( i * 20 );
+            out->sendRange( sent.back() );
+        }
+        CHECK( pump( { &sender, &receiver }, [&](){ return received.size() == sent.size(); } ) );
+        receiver.setRecorder( NULL );
+        recorder.close();
+        CHECK( received == sent );
+
+        // the log holds the receiver's config going out and every message coming in
+        Replayer replayer;
+        if ( !CHECK( replayer.open( path ) ) ) return;
+        RecordedFrame frame;
+        size_t numInbound = 0, numOutbound = 0;
+        while ( replayer.next( frame ) ){
+            ( frame.direction == RecordedFrame::DIRECTION_INBOUND ? numInbound : numOutbound )++;
+        }
+        CHECK( numInbound == sent.size() );
+        CHECK( numOutbound > 0 );
+
+        // played back into an offline Connection, at most maxFrames per call
+        Connection offline;
+        offline.addSubscribe( "in", TYPE_RANGE );
+        vector<int> replayed;
+        offline.onMessage( "in", [&]( Message m ){ replayed.push_back( m.valueRange() ); } );
+
+        replayer.start( 0 );
+        CHECK( replayer.update( offline, 8 ) == 8 );
+        offline.update();
+        CHECK( replayed.size() == 8 );
+        for ( int i = 0; i < 100 && !replayer.isDone(); i++ ){
+            replayer.update( offline, 8 );
+            offline.update();
+        }
+        CHECK( replayer.isDone() );
+        CHECK( replayed == sent );
+
+        // a threaded Connection's receive path belongs to its socket thread
+        Connection threaded;
+        threaded.setThreaded();
+        replayer.start( 0 );
+        CHECK( replayer.update( threaded ) == 0 );
+
+        replayer.close();
+        std::remove( path.c_str() );
+    }
+
+    //--------------------------------------------------------------
+    void testSuppressUnrouted(){
+        Connection sender, receiver;
+        PublisherRef maybe = sender.addPublish( "maybe", TYPE_RANGE );
+        sender.setSuppressUnrouted();
+        receiver.addSubscribe( "maybe", TYPE_RANGE );
+
+        vector<int> received;
+        receiver.onMessage( "maybe", [&]( Message m ){ received.push_back( m.valueRange() ); } );
+        if ( !CHECK( connectAll( { &sender, &receiver }, { "routes-sender", "routes-receiver" } ) ) ) return;
+        CHECK( pump( { &sender, &receiver }, [&](){ return sender.hasRouteInfo(); } ) );
+
+        // nobody listening: not even written
+        maybe->sendRange( 1 );
+        CHECK( sender.getNumUnroutedSuppressed() == 1 );
+
+        router.addRoute( "routes-sender", "maybe", "routes-receiver", "maybe" );
+        CHECK( pump( { &sender, &receiver }, [&](){ return maybe->getNumRoutes() == 1; } ) );
+        CHECK( sender.getNumRoutes( "maybe" ) == 1 );
+        maybe->sendRange( 2 );
+        CHECK( pump( { &sender, &receiver }, [&](){ return received.size() == 1; } ) );
+
+        router.removeRoute( "routes-sender", "maybe", "routes-receiver", "maybe" );
+        CHECK( pump( { &sender, &receiver }, [&](){ return maybe->getNumRoutes() == 0; } ) );
+        maybe->sendRange( 3 );
+        CHECK( sender.getNumUnroutedSuppressed() == 2 );
+
+        settle( { &sender, &receiver } );
+        CHECK( received == vector<int>( { 2 } ) );
+    }
+
+    //--------------------------------------------------------------
+    void testLanes(){
+        Connection sender, receiver;
+        PublisherRef bulk = sender.addPublish( "bulk", TYPE_RANGE );
+        receiver.addSubscribe( "bulk", TYPE_RANGE );
+        router.addRoute( "lanes-sender", "bulk", "lanes-receiver", "bulk" );
+
+        vector<int> received;
+        receiver.onMessage( "bulk", [&]( Message m ){ received.push_back( m.valueRange() ); } );
+        if ( !CHECK( connectAll( { &sender, &receiver }, { "lanes-sender", "lanes-receiver" } ) ) ) return;
+
+        sender.setInstrumentation();
+        sender.setLaneBudget( Connection::LANE_BULK, 512 );
+        sender.update();
+
+        // a budget's worth goes straight out, the rest waits for update()
+        for ( int i = 0; i < 200; i++ ) bulk->sendRange( i );
+        size_t backlog = sender.getLaneBacklog( Connection::LANE_BULK );
+        CHECK( backlog > 0 && backlog < 200 );
+        CHECK( sender.getStats().outboundQueueDepth >= backlog );
+
+        // control frames don't queue behind it
+        sender.addPublish( "late", TYPE_RANGE );
+        CHECK( sender.getLaneBacklog( Connection::LANE_CONTROL ) == 0 );
+
+        // each pass drains about one budget
+        sender.update();
+        size_t after = sender.getLaneBacklog( Connection::LANE_BULK );
+        CHECK( after < backlog && after > 0 );
+
+        CHECK( pump( { &sender, &receiver }, [&](){ return received.size() == 200; } ) );
+        CHECK( sender.getLaneBacklog( Connection::LANE_BULK ) == 0 );
+        bool bInOrder = received.size() == 200;
+        for ( size_t i = 0; i < received.size() && bInOrder; i++ ){
+            bInOrder = received[i] == (int) i;
+        }
+        CHECK( bInOrder );
+    }
+}
+
+int main(){
+    if ( !router.listen( kPort ) ){
+        printf( "couldn't listen on port %d\n", kPort );
+        return 1;
+    }
+    router.start();
+
+    testValues();
+    testNestedValues();
+    testRateLimit();
+    testFloatArrays();
+    testEscapedStrings();
+    testOfflineBuffer();
+    testBackoff();
+    testRecordReplay();
+    testSuppressUnrouted();
+    testLanes();
+
+    router.stop();
+    return test::finish( "LoopbackTests" );
+}
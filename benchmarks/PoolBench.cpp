@@ -0,0 +1,111 @@
+//
+//  PoolBench.cpp
+//  ciSpacebrew benchmarks
+//
+//  Many Connections driven by one ConnectionPool, with the pool's worker count swept
+//  from 1 up to the number of cores. Clients form a ring (each one's "out" is routed to
+//  the next one's "in") across several in-process Routers, so the server side isn't the
+//  bottleneck. Reports delivered messages per second for each worker count.
+//
+//  Usage: PoolBench [numClients=512] [messagesPerClient=200]
+//
+
+#include "ciSpacebrew.h"
+#include "ciSpacebrewRouter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+using namespace std;
+
+static int64_t nowNanos(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+int main( int argc, char * argv[] ){
+    const size_t    numClients          = argc > 1 ? atoi( argv[1] ) : 512;
+    const int       messagesPerClient   = argc > 2 ? atoi( argv[2] ) : 200;
+    const size_t    numCores            = std::max( 1u, std::thread::hardware_concurrency() );
+    const size_t    numRouters          = std::max( (size_t) 1, numCores / 2 );
+    const uint16_t  basePort            = 9900;
+    
+    vector< unique_ptr<Spacebrew::Router> > routers;
+    for ( size_t r = 0; r < numRouters; r++ ){
+        routers.push_back( unique_ptr<Spacebrew::Router>( new Spacebrew::Router() ) );
+        if ( !routers.back()->listen( basePort + r ) ) return 1;
+        routers.back()->start();
+    }
+    
+    printf( "%d clients, %d messages each, %d routers\n", (int) numClients, messagesPerClient, (int) numRouters );
+    
+    for ( size_t numThreads = 1; numThreads <= numCores; numThreads *= 2 ){
+        Spacebrew::ConnectionPool pool( numThreads );
+        
+        vector< unique_ptr<Spacebrew::Connection> > clients;
+        vector<Spacebrew::PublisherRef>             outs;
+        size_t                                      received = 0;
+        
+        for ( size_t i = 0; i < numClients; i++ ){
+            // clients sharing a router form their own ring
+            size_t  router  = i % numRouters;
+            size_t  next    = ( i + numRouters ) % numClients;
+            string  name    = "sim-" + to_string( numThreads ) + "-" + to_string( i );
+            string  nextName = "sim-" + to_string( numThreads ) + "-" + to_string( next );
+            routers[ router ]->addRoute( name, "out", nextName, "in" );
+            
+            clients.push_back( unique_ptr<Spacebrew::Connection>( new Spacebrew::Connection() ) );
+            Spacebrew::Connection & c = *clients.back();
+            c.setThreaded( pool, 256 );
+            outs.push_back( c.addPublish( "out", Spacebrew::TYPE_RANGE ) );
+            c.addSubscribe( "in", Spacebrew::TYPE_RANGE );
+            c.onMessage( "in", [&]( Spacebrew::Message ){ received++; } );
+            c.connect( "ws://localhost:" + to_string( basePort + router ), name, "" );
+        }
+        
+        // wait for everyone to be connected and configured
+        size_t  expectedClients = numClients;
+        int64_t deadline        = nowNanos() + 20000000000LL;
+        for (;;){
+            pool.update();
+            size_t numConfigured = 0;
+            for ( size_t r = 0; r < numRouters; r++ ) numConfigured += routers[r]->getClientNames().size();
+            if ( numConfigured >= expectedClients ) break;
+            if ( nowNanos() > deadline ){
+                printf( "only %d of %d clients connected\n", (int) numConfigured, (int) numClients );
+                return 1;
+            }
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        }
+        
+        size_t  target  = (size_t) messagesPerClient * numClients;
+        int64_t start   = nowNanos();
+        for ( int m = 0; m < messagesPerClient; m++ ){
+            for ( size_t i = 0; i < numClients; i++ ){
+                outs[i]->sendRange( m & 1023 );
+            }
+            pool.update();
+        }
+        deadline = nowNanos() + 30000000000LL;
+        while ( received < target && nowNanos() < deadline ){
+            pool.update();
+            std::this_thread::yield();
+        }
+        double seconds = ( nowNanos() - start ) / 1e9;
+        
+        size_t dropped = 0;
+        for ( size_t i = 0; i < numClients; i++ ) dropped += clients[i]->getNumDroppedWrites();
+        
+        printf( "%2d workers: %8d / %d delivered in %.3f s, %10.0f msgs/s (%d dropped on send)\n",
+            (int) numThreads, (int) received, (int) target, seconds, received / seconds, (int) dropped );
+        
+        // the pool has to outlive its clients
+        clients.clear();
+    }
+    
+    for ( size_t r = 0; r < numRouters; r++ ){
+        routers[r]->stop();
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+//
+//  SpacebrewBench.cpp
+//  ciSpacebrew benchmarks
+//
+//  Headless benchmarks for the library's hot paths: Message::getJSON, Config::getJSON,
+//  Connection::onRead and message dispatch. No window or App is created, frames are fed
+//  straight into the Connection. See CMakeLists.txt for building.
+//
+
+#include "BenchUtil.h"
+#include "ciSpacebrew.h"
+
+using namespace std;
+
+// exposes the dispatch step on its own, without parsing
+class BenchConnection : public Spacebrew::Connection {
+  public:
+    void dispatch( Spacebrew::Message & m ){ handleMessage( m ); }
+};
+
+static void benchMessageJSON(){
+    printf( "-- Message::getJSON --\n" );
+    
+    Spacebrew::Message range( "backgroundColor", Spacebrew::TYPE_RANGE, "512" );
+    Spacebrew::Message str( "greeting", Spacebrew::TYPE_STRING, "hello there!" );
+    const string clientName = "cinder-button-example";
+    string out;
+    
+    bench::run( "getJSON range", 1000000, [&](){
+        string json = range.getJSON( clientName );
+        bench::doNotOptimize( json );
+    });
+    bench::run( "getJSON string", 1000000, [&](){
+        string json = str.getJSON( clientName );
+        bench::doNotOptimize( json );
+    });
+    bench::run( "writeJSON range (reused buffer)", 1000000, [&](){
+        range.writeJSON( out, clientName );
+        bench::doNotOptimize( out );
+    });
+}
+
+static void benchConfigJSON(){
+    printf( "-- Config::getJSON --\n" );
+    
+    const int sizes[] = { 10, 1000, 10000 };
+    for ( int s = 0; s < 3; s++ ){
+        Spacebrew::Config config;
+        config.name = "bench";
+        for ( int i = 0; i < sizes[s]; i++ ){
+            config.addPublish( "publisher" + to_string( i ), Spacebrew::TYPE_RANGE, "0" );
+            config.addSubscribe( "subscriber" + to_string( i ), Spacebrew::TYPE_STRING );
+        }
+        
+        size_t bytes        = config.getJSON().size();
+        size_t iterations   = 20000000 / ( sizes[s] * 10 );
+        char label[ 64 ];
+        
+        // flipping the description defeats the cache, so this is the full serialization
+        int flip = 0;
+        snprintf( label, sizeof(label), "rebuild, %d channels", sizes[s] );
+        bench::run( label, iterations, [&](){
+            config.description = ( flip++ & 1 ) ? "a" : "b";
+            bench::doNotOptimize( config.getJSON() );
+        }, bytes );
+        
+        snprintf( label, sizeof(label), "cached, %d channels", sizes[s] );
+        bench::run( label, iterations, [&](){
+            bench::doNotOptimize( config.getJSON() );
+        });
+    }
+}
+
+static void benchOnRead(){
+    printf( "-- Connection::onRead --\n" );
+    
+    BenchConnection connection;
+    const string range      = "{\"message\":{\"clientName\":\"slider\",\"name\":\"backgroundColor\",\"type\":\"range\",\"value\":512}}";
+    const string str        = "{\"message\":{\"clientName\":\"chat\",\"name\":\"text\",\"type\":\"string\",\"value\":\"hello there!\"}}";
+    const string custom     = "{\"message\":{\"clientName\":\"kinect\",\"name\":\"hand\",\"type\":\"point\",\"value\":{\"x\":1,\"y\":2}}}";
+    
+    bench::run( "onRead range (fast path)", 1000000, [&](){
+        connection.onRead( range );
+    }, range.size() );
+    bench::run( "onRead string (fast path)", 1000000, [&](){
+        connection.onRead( str );
+    }, str.size() );
+    bench::run( "onRead nested custom (JsonTree)", 100000, [&](){
+        connection.onRead( custom );
+    }, custom.size() );
+}
+
+static void benchDispatch(){
+    printf( "-- dispatch --\n" );
+    
+    const int counts[] = { 1, 10, 100 };
+    for ( int c = 0; c < 3; c++ ){
+        BenchConnection connection;
+        int received = 0;
+        for ( int i = 0; i < counts[c]; i++ ){
+            connection.signalOnMessage.connect( [&]( Spacebrew::Message m ){ received += m.valueRange(); } );
+        }
+        
+        Spacebrew::Message m( "backgroundColor", Spacebrew::TYPE_RANGE, "512" );
+        char label[ 64 ];
+        snprintf( label, sizeof(label), "signalOnMessage, %d listeners", counts[c] );
+        bench::run( label, 2000000 / counts[c], [&](){
+            connection.dispatch( m );
+        });
+        bench::doNotOptimize( received );
+    }
+    
+    for ( int c = 0; c < 3; c++ ){
+        BenchConnection connection;
+        int received = 0;
+        for ( int i = 0; i < counts[c]; i++ ){
+            string name = "subscription" + to_string( i );
+            connection.addSubscribe( name, Spacebrew::TYPE_RANGE );
+            connection.onMessage( name, [&]( Spacebrew::Message m ){ received += m.valueRange(); } );
+        }
+        
+        Spacebrew::Message m( "subscription0", Spacebrew::TYPE_RANGE, "512" );
+        char label[ 64 ];
+        snprintf( label, sizeof(label), "onMessage( name ), %d subscriptions", counts[c] );
+        bench::run( label, 2000000, [&](){
+            connection.dispatch( m );
+        });
+        bench::doNotOptimize( received );
+    }
+}
+
+int main(){
+    benchMessageJSON();
+    benchConfigJSON();
+    benchOnRead();
+    benchDispatch();
+    return 0;
+}
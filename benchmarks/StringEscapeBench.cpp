@@ -0,0 +1,127 @@
+//
+//  StringEscapeBench.cpp
+//  ciSpacebrew benchmarks
+//
+//  JSON string escaping (JsonWriter::quoted) and in-place unescaping (parseMessageFrame) against
+//  plain per-character loops, for string payloads from 16 B to 64 KB.
+//  Build: c++ -std=c++11 -O2 -I../src StringEscapeBench.cpp ../src/ciSpacebrewJson.cpp -o StringEscapeBench
+//
+
+#include "BenchUtil.h"
+#include "ciSpacebrewJson.h"
+
+#include <vector>
+
+using namespace std;
+
+// the obvious one character at a time escape, kept here as the baseline
+static void naiveQuoted( string & out, const string & s ){
+    static const char kHex[] = "0123456789abcdef";
+    out.push_back( '"' );
+    for ( size_t i = 0; i < s.size(); i++ ){
+        unsigned char c = (unsigned char) s[i];
+        switch ( c ){
+            case '"':   out += "\\\""; break;
+            case '\\':  out += "\\\\"; break;
+            case '\n':  out += "\\n"; break;
+            case '\r':  out += "\\r"; break;
+            case '\t':  out += "\\t"; break;
+            default:
+                if ( c < 0x20 ){
+                    out += "\\u00";
+                    out.push_back( kHex[ c >> 4 ] );
+                    out.push_back( kHex[ c & 15 ] );
+                } else {
+                    out.push_back( (char) c );
+                }
+        }
+    }
+    out.push_back( '"' );
+}
+
+// and the matching one character at a time unescape (simple escapes only)
+static void naiveUnescape( string & out, const char * s, size_t len ){
+    out.clear();
+    for ( size_t i = 0; i < len; i++ ){
+        if ( s[i] == '\\' && i + 1 < len ){
+            char e = s[++i];
+            out.push_back( e == 'n' ? '\n' : e == 't' ? '\t' : e == 'r' ? '\r' : e );
+        } else {
+            out.push_back( s[i] );
+        }
+    }
+}
+
+// chat-like text; every escapeEvery characters one needs escaping (0 = clean)
+static string makePayload( size_t len, size_t escapeEvery ){
+    static const char kText[] = "the quick brown fox jumps over the lazy dog, said nobody at the gallery opening. ";
+    string s;
+    for ( size_t i = 0; i < len; i++ ){
+        if ( escapeEvery && i % escapeEvery == escapeEvery - 1 ){
+            s.push_back( i & 1 ? '"' : '\n' );
+        } else {
+            s.push_back( kText[ i % ( sizeof(kText) - 1 ) ] );
+        }
+    }
+    return s;
+}
+
+int main(){
+    const size_t sizes[] = { 16, 256, 4096, 65536 };
+    string out, frame, scratch;
+    
+    for ( size_t k = 0; k < 2; k++ ){
+        size_t escapeEvery = k == 0 ? 0 : 64;
+        printf( "-- %s payloads --\n", escapeEvery ? "1 in 64 escaped" : "clean" );
+        
+        for ( size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++ ){
+            string  payload = makePayload( sizes[i], escapeEvery );
+            size_t  N       = 64 * 1024 * 1024 / ( sizes[i] * 16 ) + 1000;
+            char    label[ 64 ];
+            
+            snprintf( label, sizeof(label), "escape %6d B, per character", (int) sizes[i] );
+            bench::run( label, N, [&](){
+                out.clear();
+                naiveQuoted( out, payload );
+                bench::doNotOptimize( out );
+            }, payload.size() );
+            
+            snprintf( label, sizeof(label), "escape %6d B, JsonWriter::quoted", (int) sizes[i] );
+            bench::run( label, N, [&](){
+                Spacebrew::JsonWriter writer( out );
+                writer.reset();
+                writer.quoted( payload );
+                bench::doNotOptimize( out );
+            }, payload.size() );
+            
+            // a complete frame for the read side
+            Spacebrew::JsonWriter writer( frame );
+            writer.reset();
+            writer.message( "chat", "text", "string", payload );
+            
+            scratch = frame;
+            Spacebrew::MessageFrame parsed;
+            if ( !Spacebrew::parseMessageFrame( &scratch[0], scratch.size(), parsed ) || parsed.value.str() != payload ){
+                printf( "ROUND TRIP FAILED at %d bytes\n", (int) sizes[i] );
+                return 1;
+            }
+            
+            size_t valueStart = frame.find( ",\"value\":\"" ) + 10;
+            size_t valueLen = frame.size() - 3 - valueStart;
+            snprintf( label, sizeof(label), "unescape %6d B, per character", (int) sizes[i] );
+            bench::run( label, N, [&](){
+                naiveUnescape( out, frame.data() + valueStart, valueLen );
+                bench::doNotOptimize( out );
+            }, payload.size() );
+            
+            snprintf( label, sizeof(label), "unescape %6d B, parseMessageFrame", (int) sizes[i] );
+            bench::run( label, N, [&](){
+                scratch.assign( frame );
+                Spacebrew::MessageFrame f;
+                Spacebrew::parseMessageFrame( &scratch[0], scratch.size(), f );
+                bench::doNotOptimize( f );
+            }, payload.size() );
+        }
+    }
+    return 0;
+}
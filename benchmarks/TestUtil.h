@@ -0,0 +1,50 @@
+//
+//  TestUtil.h
+//  ciSpacebrew benchmarks
+//
+//  Minimal check harness for the behaviour tests that live next to the benchmarks. A failed
+//  CHECK prints where and what, and test::finish() turns the tally into the exit code so ctest
+//  can run the tests directly.
+//
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+namespace test {
+
+    static int sChecks      = 0;
+    static int sFailures    = 0;
+
+    inline bool check( bool bOk, const char * expr, const char * file, int line ){
+        sChecks++;
+        if ( !bOk ){
+            sFailures++;
+            printf( "%s:%d: CHECK( %s ) failed\n", file, line, expr );
+        }
+        return bOk;
+    }
+
+    /**
+     * @brief Like check(), but prints both strings on a mismatch
+     */
+    inline bool checkEqual( const std::string & a, const std::string & b, const char * expr, const char * file, int line ){
+        if ( !check( a == b, expr, file, line ) ){
+            printf( "    got      \"%s\"\n    expected \"%s\"\n", a.c_str(), b.c_str() );
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Print the summary for suite, returns the process exit code
+     */
+    inline int finish( const char * suite ){
+        printf( "%-24s %d checks, %d failed\n", suite, sChecks, sFailures );
+        return sFailures ? 1 : 0;
+    }
+}
+
+#define CHECK( expr )           test::check( !!( expr ), #expr, __FILE__, __LINE__ )
+#define CHECK_EQUAL( a, b )     test::checkEqual( ( a ), ( b ), #a " == " #b, __FILE__, __LINE__ )
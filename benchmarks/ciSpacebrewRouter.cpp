@@ -0,0 +1,371 @@
+//
+//  ciSpacebrewRouter.cpp
+//  ciSpacebrew
+//
+
+#include "ciSpacebrewRouter.h"
+
+
+namespace Spacebrew {
+    
+    namespace {
+        
+        inline void makeRouteKey( string & key, const string & client, const string & name ){
+            key.assign( client );
+            key.push_back( '\n' );
+            key.append( name );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    Router::Router(){
+        bRunning        = false;
+        numForwarded    = 0;
+        
+        server.clear_access_channels( websocketpp::log::alevel::all );
+        server.clear_error_channels( websocketpp::log::elevel::all );
+        server.init_asio();
+        server.set_reuse_addr( true );
+        
+        server.set_open_handler( std::bind( &Router::onOpen, this, std::placeholders::_1 ) );
+        server.set_close_handler( std::bind( &Router::onClose, this, std::placeholders::_1 ) );
+        server.set_message_handler( std::bind( &Router::onMessage, this, std::placeholders::_1, std::placeholders::_2 ) );
+    }
+    
+    //--------------------------------------------------------------
+    Router::~Router(){
+        stop();
+    }
+    
+    //--------------------------------------------------------------
+    bool Router::listen( uint16_t port ){
+        websocketpp::lib::error_code ec;
+        server.listen( port, ec );
+        if ( ec ){
+            SPACEBREW_LOG_ERROR( "Spacebrew::Router couldn't listen on " << port << ": " << ec.message() );
+            return false;
+        }
+        server.start_accept( ec );
+        return !ec;
+    }
+    
+    //--------------------------------------------------------------
+    void Router::start(){
+        if ( bRunning ){
+            return;
+        }
+        bRunning = true;
+        thread = std::thread( [this](){ server.run(); } );
+    }
+    
+    //--------------------------------------------------------------
+    void Router::stop(){
+        websocketpp::lib::error_code ec;
+        server.stop_listening( ec );
+        
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            for ( std::map< Handle, Client, std::owner_less<Handle> >::iterator it = clients.begin(); it != clients.end(); ++it ){
+                server.close( it->first, websocketpp::close::status::going_away, "", ec );
+            }
+        }
+        
+        server.stop();
+        if ( thread.joinable() ){
+            thread.join();
+        }
+        bRunning = false;
+    }
+    
+    //--------------------------------------------------------------
+    void Router::poll(){
+        server.poll();
+    }
+    
+    //--------------------------------------------------------------
+    void Router::addRoute( const string & pubClient, const string & pubName, const string & subClient, const string & subName ){
+        std::lock_guard<std::mutex> lock( mutex );
+        
+        string key;
+        makeRouteKey( key, pubClient, pubName );
+        vector<Route> & list = routes[ key ];
+        for ( size_t i = 0; i < list.size(); i++ ){
+            if ( list[i].subClient == subClient && list[i].subName == subName ){
+                return;
+            }
+        }
+        Route r;
+        r.subClient = subClient;
+        r.subName   = subName;
+        list.push_back( r );
+        
+        writeRoute( adminBuffer, true, pubClient, pubName, subClient, subName );
+        sendToAdmins( adminBuffer );
+    }
+    
+    //--------------------------------------------------------------
+    void Router::removeRoute( const string & pubClient, const string & pubName, const string & subClient, const string & subName ){
+        std::lock_guard<std::mutex> lock( mutex );
+        
+        string key;
+        makeRouteKey( key, pubClient, pubName );
+        unordered_map< string, vector<Route> >::iterator it = routes.find( key );
+        if ( it == routes.end() ){
+            return;
+        }
+        vector<Route> & list = it->second;
+        for ( size_t i = 0; i < list.size(); i++ ){
+            if ( list[i].subClient == subClient && list[i].subName == subName ){
+                list.erase( list.begin() + i );
+                writeRoute( adminBuffer, false, pubClient, pubName, subClient, subName );
+                sendToAdmins( adminBuffer );
+                break;
+            }
+        }
+        if ( list.empty() ){
+            routes.erase( it );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    vector<string> Router::getClientNames(){
+        std::lock_guard<std::mutex> lock( mutex );
+        
+        vector<string> names;
+        for ( std::map< Handle, Client, std::owner_less<Handle> >::iterator it = clients.begin(); it != clients.end(); ++it ){
+            if ( it->second.bConfigured ){
+                names.push_back( it->second.config.name );
+            }
+        }
+        return names;
+    }
+    
+    //--------------------------------------------------------------
+    void Router::onOpen( Handle hdl ){
+        std::lock_guard<std::mutex> lock( mutex );
+        Client & client     = clients[ hdl ];
+        client.bConfigured  = false;
+        client.bAdmin       = false;
+    }
+    
+    //--------------------------------------------------------------
+    void Router::onClose( Handle hdl ){
+        std::lock_guard<std::mutex> lock( mutex );
+        
+        std::map< Handle, Client, std::owner_less<Handle> >::iterator it = clients.find( hdl );
+        if ( it == clients.end() ){
+            return;
+        }
+        
+        // routes are kept, they apply again if a client with the same name comes back
+        std::pair< std::multimap<string, Handle>::iterator, std::multimap<string, Handle>::iterator > range = clientsByName.equal_range( it->second.config.name );
+        for ( std::multimap<string, Handle>::iterator n = range.first; n != range.second; ++n ){
+            if ( !n->second.owner_before( hdl ) && !hdl.owner_before( n->second ) ){
+                clientsByName.erase( n );
+                break;
+            }
+        }
+        clients.erase( it );
+    }
+    
+    //--------------------------------------------------------------
+    void Router::onMessage( Handle hdl, Server::message_ptr msg ){
+        std::lock_guard<std::mutex> lock( mutex );
+        
+        // parsed in place, so work on our own copy
+        payloadBuffer.assign( msg->get_payload() );
+        
+        MessageFrame frame;
+        if ( parseMessageFrame( &payloadBuffer[0], payloadBuffer.size(), frame ) ){
+            forward( frame );
+            return;
+        }
+        
+        try {
+            JsonTree j( msg->get_payload() );
+            if ( j.hasChild( "config" ) ){
+                handleConfig( hdl, msg->get_payload() );
+            } else if ( j.hasChild( "admin" ) ){
+                handleAdmin( hdl );
+            } else if ( j.hasChild( "message" ) ){
+                // values the fast path leaves alone (nested objects and arrays of strings)
+                const JsonTree & m = j.getChild( "message" );
+                string name     = m.getChild( "name" ).getValue();
+                string type     = m.getChild( "type" ).getValue();
+                string client   = m.getChild( "clientName" ).getValue();
+                const JsonTree & v = m.getChild( "value" );
+                bool bScalar    = v.getNodeType() == JsonTree::NODE_VALUE;
+                string value    = bScalar ? v.getValue() : v.serialize();
+                
+                // JsonTree hands back scalars unquoted and unescaped; anything that isn't a JSON
+                // literal has to go back out as a string, whatever the type
+                double number;
+                frame.clientName    = StringRef( client );
+                frame.name          = StringRef( name );
+                frame.type          = StringRef( type );
+                frame.value         = StringRef( value );
+                frame.bValueQuoted  = bScalar && ( JsonWriter::isQuotedType( type ) ||
+                                      !( value == "true" || value == "false" || value == "null" || parseNumber( value, number ) ) );
+                forward( frame );
+            }
+        } catch ( ... ){
+            SPACEBREW_LOG_WARNING( "Spacebrew::Router dropped unreadable frame: " << msg->get_payload() );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Router::handleConfig( Handle hdl, const string & frame ){
+        JsonTree j( frame );
+        const JsonTree & c = j.getChild( "config" );
+        
+        Client & client     = clients[ hdl ];
+        string oldName      = client.config.name;
+        bool bWasConfigured = client.bConfigured;
+        
+        client.config               = Config();
+        client.config.name          = c.getChild( "name" ).getValue();
+        client.config.description   = c.hasChild( "description" ) ? c.getChild( "description" ).getValue() : "";
+        
+        if ( c.hasChild( "publish" ) && c.getChild( "publish" ).hasChild( "messages" ) ){
+            const JsonTree & list = c.getChild( "publish" ).getChild( "messages" );
+            for ( JsonTree::ConstIter it = list.begin(); it != list.end(); ++it ){
+                string def = it->hasChild( "default" ) ? it->getChild( "default" ).getValue() : "";
+                client.config.addPublish( it->getChild( "name" ).getValue(), it->getChild( "type" ).getValue(), def );
+            }
+        }
+        if ( c.hasChild( "subscribe" ) && c.getChild( "subscribe" ).hasChild( "messages" ) ){
+            const JsonTree & list = c.getChild( "subscribe" ).getChild( "messages" );
+            for ( JsonTree::ConstIter it = list.begin(); it != list.end(); ++it ){
+                client.config.addSubscribe( it->getChild( "name" ).getValue(), it->getChild( "type" ).getValue() );
+            }
+        }
+        client.bConfigured = true;
+        
+        // clients resend their config whenever pub/sub changes; only the name index needs care
+        if ( bWasConfigured && oldName == client.config.name ){
+            return;
+        }
+        if ( bWasConfigured ){
+            std::pair< std::multimap<string, Handle>::iterator, std::multimap<string, Handle>::iterator > range = clientsByName.equal_range( oldName );
+            for ( std::multimap<string, Handle>::iterator n = range.first; n != range.second; ++n ){
+                if ( !n->second.owner_before( hdl ) && !hdl.owner_before( n->second ) ){
+                    clientsByName.erase( n );
+                    break;
+                }
+            }
+        }
+        clientsByName.insert( std::make_pair( client.config.name, hdl ) );
+    }
+    
+    //--------------------------------------------------------------
+    void Router::handleAdmin( Handle hdl ){
+        clients[ hdl ].bAdmin = true;
+        
+        // the current state in one array: configs first, then routes
+        string state = "[";
+        for ( std::map< Handle, Client, std::owner_less<Handle> >::iterator it = clients.begin(); it != clients.end(); ++it ){
+            if ( it->second.bConfigured ){
+                if ( state.size() > 1 ) state.push_back( ',' );
+                state.append( it->second.config.getJSON() );
+            }
+        }
+        for ( unordered_map< string, vector<Route> >::iterator it = routes.begin(); it != routes.end(); ++it ){
+            size_t split        = it->first.find( '\n' );
+            string pubClient    = it->first.substr( 0, split );
+            string pubName      = it->first.substr( split + 1 );
+            for ( size_t i = 0; i < it->second.size(); i++ ){
+                writeRoute( adminBuffer, true, pubClient, pubName, it->second[i].subClient, it->second[i].subName );
+                if ( state.size() > 1 ) state.push_back( ',' );
+                state.append( adminBuffer );
+            }
+        }
+        state.push_back( ']' );
+        
+        websocketpp::lib::error_code ec;
+        server.send( hdl, state, websocketpp::frame::opcode::text, ec );
+    }
+    
+    //--------------------------------------------------------------
+    void Router::writeRoute( string & out, bool bAdd, const string & pubClient, const string & pubName, const string & subClient, const string & subName ){
+        JsonWriter writer( out );
+        writer.reset();
+        writer.raw( bAdd ? "{\"route\":{\"type\":\"add\"" : "{\"route\":{\"type\":\"remove\"" );
+        writer.raw( ",\"publisher\":{\"clientName\":" );
+        writer.quoted( pubClient );
+        writer.raw( ",\"name\":" );
+        writer.quoted( pubName );
+        writer.raw( "},\"subscriber\":{\"clientName\":" );
+        writer.quoted( subClient );
+        writer.raw( ",\"name\":" );
+        writer.quoted( subName );
+        writer.raw( "}}}" );
+    }
+    
+    //--------------------------------------------------------------
+    void Router::sendToAdmins( const string & frame ){
+        websocketpp::lib::error_code ec;
+        for ( std::map< Handle, Client, std::owner_less<Handle> >::iterator it = clients.begin(); it != clients.end(); ++it ){
+            if ( it->second.bAdmin ){
+                server.send( it->first, frame, websocketpp::frame::opcode::text, ec );
+            }
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Router::forward( const MessageFrame & frame ){
+        keyBuffer.assign( frame.clientName.data, frame.clientName.size );
+        keyBuffer.push_back( '\n' );
+        keyBuffer.append( frame.name.data, frame.name.size );
+        
+        unordered_map< string, vector<Route> >::iterator it = routes.find( keyBuffer );
+        if ( it == routes.end() ){
+            return;
+        }
+        
+        const vector<Route> & list = it->second;
+        for ( size_t i = 0; i < list.size(); i++ ){
+            const Route & route = list[i];
+            
+            std::pair< std::multimap<string, Handle>::iterator, std::multimap<string, Handle>::iterator > range = clientsByName.equal_range( route.subClient );
+            for ( std::multimap<string, Handle>::iterator n = range.first; n != range.second; ++n ){
+                
+                // only deliver to subscribers of the same type
+                const vector<Message> & subs = clients[ n->second ].config.getSubscribe();
+                bool bSubscribed = false;
+                for ( size_t s = 0; s < subs.size() && !bSubscribed; s++ ){
+                    bSubscribed = subs[s].name == route.subName && StringRef( subs[s].type ) == frame.type;
+                }
+                if ( !bSubscribed ){
+                    continue;
+                }
+                
+                JsonWriter writer( outBuffer );
+                writer.reset();
+                writer.raw( "{\"message\":{\"clientName\":" );
+                writer.quoted( route.subClient );
+                writer.raw( ",\"name\":" );
+                writer.quoted( route.subName );
+                writer.raw( ",\"type\":" );
+                writer.quoted( frame.type.data, frame.type.size );
+                writer.raw( ",\"value\":" );
+                if ( frame.bValueQuoted ){
+                    writer.quoted( frame.value.data, frame.value.size );
+                } else {
+                    writer.raw( frame.value.data, frame.value.size );
+                }
+                writer.raw( "}}" );
+                
+                send( n->second, outBuffer );
+            }
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Router::send( Handle hdl, const string & frame ){
+        websocketpp::lib::error_code ec;
+        server.send( hdl, frame, websocketpp::frame::opcode::text, ec );
+        if ( !ec ){
+            numForwarded++;
+        }
+    }
+}
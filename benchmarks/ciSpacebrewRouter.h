@@ -0,0 +1,121 @@
+//
+//  ciSpacebrewRouter.h
+//  ciSpacebrew
+//
+//  Small embeddable Spacebrew server for loopback testing and benchmarking, so
+//  Connections can talk to each other without a Node server. Not part of the block:
+//  build ciSpacebrewRouter.cpp into the test or benchmark that needs it.
+//
+
+#pragma once
+
+#include "ciSpacebrew.h"
+
+#include "websocketpp/config/asio_no_tls.hpp"
+#include "websocketpp/server.hpp"
+
+#include <map>
+#include <mutex>
+
+namespace Spacebrew {
+
+    /**
+     * @brief Accepts Spacebrew clients over WebSocket, keeps their configs and a route table, and forwards
+     * {"message":...} frames from publishers to routed subscribers. Only what the client side needs is
+     * implemented: admins get the route list and route changes (no message copies, no routing requests
+     * from admins), and there is no remote address matching.
+     * @example
+     * Spacebrew::Router router;
+     * router.listen( 9000 );
+     * router.start();
+     * router.addRoute( "sender", "out", "receiver", "in" );
+     * @class Spacebrew::Router
+     */
+    class Router {
+      public:
+        Router();
+        ~Router();
+
+        /**
+         * @brief Start accepting clients
+         * @param {uint16_t} port
+         * @return false if the port couldn't be bound
+         */
+        bool listen( uint16_t port = SPACEBREW_PORT );
+
+        /**
+         * @brief Run the server on a background thread
+         */
+        void start();
+
+        /**
+         * @brief Stop the background thread and close all clients
+         */
+        void stop();
+
+        /**
+         * @brief Or drive it yourself: handle whatever is ready and return
+         */
+        void poll();
+
+        /**
+         * @brief Route a publisher to a subscriber. Types have to match when the message is forwarded.
+         * Can be called before either client has connected.
+         */
+        void addRoute( const string & pubClient, const string & pubName, const string & subClient, const string & subName );
+        void removeRoute( const string & pubClient, const string & pubName, const string & subClient, const string & subName );
+
+        /**
+         * @return Names of clients that have sent a config
+         */
+        vector<string> getClientNames();
+
+        /**
+         * @return Number of message frames sent to subscribers
+         */
+        size_t getNumForwarded() const { return numForwarded; }
+
+      protected:
+        typedef websocketpp::server<websocketpp::config::asio>  Server;
+        typedef websocketpp::connection_hdl                     Handle;
+
+        struct Client {
+            Config  config;
+            bool    bConfigured;
+            bool    bAdmin;
+        };
+
+        struct Route {
+            string  subClient;
+            string  subName;
+        };
+
+        void onOpen( Handle hdl );
+        void onClose( Handle hdl );
+        void onMessage( Handle hdl, Server::message_ptr msg );
+
+        void handleConfig( Handle hdl, const string & frame );
+        void handleAdmin( Handle hdl );
+        void writeRoute( string & out, bool bAdd, const string & pubClient, const string & pubName, const string & subClient, const string & subName );
+        void sendToAdmins( const string & frame );
+        void forward( const MessageFrame & frame );
+        void send( Handle hdl, const string & frame );
+
+        Server                  server;
+        std::thread             thread;
+        std::atomic<bool>       bRunning;
+        std::mutex              mutex;
+
+        std::map< Handle, Client, std::owner_less<Handle> >     clients;
+        std::multimap< string, Handle >                         clientsByName;
+
+        // keyed on "pubClient\npubName"
+        unordered_map< string, vector<Route> >                  routes;
+
+        string                  keyBuffer;
+        string                  payloadBuffer;
+        string                  outBuffer;
+        string                  adminBuffer;
+        std::atomic<size_t>     numForwarded;
+    };
+}
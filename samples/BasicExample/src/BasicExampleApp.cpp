@@ -5,9 +5,9 @@
 
 #include "ciSpacebrew.h"
 #include <boost/signals2.hpp>
-#include <boost/lambda/lambda.hpp>
 
 using namespace ci;
+using namespace ci::app;
 using namespace std;
 
 class BasicExampleApp : public AppNative {
@@ -17,7 +17,8 @@ class BasicExampleApp : public AppNative {
 	void mouseDown( MouseEvent event );	
 	void update();
 	void draw();
-    void onMessage( Spacebrew::Message msg );
+    void onBackgroundColor( Spacebrew::Message msg );
+    void onDrawIcon( Spacebrew::Message msg );
     
     bool                        bDrawIcon;
     float                       mBgColor;
@@ -47,19 +48,21 @@ void BasicExampleApp::setup() {
     // Connect to websocket host
     mSpacebrew.connect( host, name, description );
     
-    // Connect to boost signals for event messages
-    // Other signals include signalOnMessage, signalOnConnect, signalOnDisconnect, signalOnError, signalOnInterrupt, signalOnPing
-    mSpacebrew.signalOnMessage.connect( boost::bind( &BasicExampleApp::onMessage, this, boost::lambda::_1 ) );
+    // Listen to each subscription by name, only that subscription's messages reach the handler.
+    // signalOnMessage still receives every message, other signals include signalOnConnect,
+    // signalOnDisconnect, signalOnError, signalOnInterrupt, signalOnPing
+    mSpacebrew.addListener( "backgroundColor", &BasicExampleApp::onBackgroundColor, this );
+    mSpacebrew.addListener( "drawIcon", &BasicExampleApp::onDrawIcon, this );
     
     gl::enableAlphaBlending();
 }
 
-void BasicExampleApp::onMessage( Spacebrew::Message msg ) {
-    if( msg.type == Spacebrew::TYPE_BOOLEAN ){
-        bDrawIcon = msg.valueBoolean();
-    }else if( msg.type == Spacebrew::TYPE_RANGE ){
-        mBgColor = msg.valueRange() / 1023.0f;
-    }
+void BasicExampleApp::onBackgroundColor( Spacebrew::Message msg ) {
+    mBgColor = msg.valueRange() / 1023.0f;
+}
+
+void BasicExampleApp::onDrawIcon( Spacebrew::Message msg ) {
+    bDrawIcon = msg.valueBoolean();
 }
 
 void BasicExampleApp::mouseDown( MouseEvent event ) {
@@ -8,8 +8,20 @@
 
 #include "ciSpacebrew.h"
 
+#include <algorithm>
+#include <chrono>
+
 namespace Spacebrew {
     
+    namespace {
+        
+        // no App here, so no app clock or console
+        int getElapsedMillis(){
+            static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            return (int) std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start ).count();
+        }
+    }
+    
 #pragma mark Message
     
     //--------------------------------------------------------------
@@ -17,85 +29,322 @@ namespace Spacebrew {
         name = _name;
         type = _type;
         _default = value = _val;
+        parseValue();
     }
     
     //--------------------------------------------------------------
     string Message::getJSON( string configName ){
-        if ( type == "string" || type == "boolean" ){
-            return "{\"message\":{\"clientName\":\"" + configName +"\",\"name\":\"" + name + "\",\"type\":\"" + type + "\",\"value\":\"" + value +"\"}}";
+        string out;
+        writeJSON( out, configName );
+        return out;
+    }
+    
+    //--------------------------------------------------------------
+    void Message::writeJSON( string & out, const string & configName ) const {
+        JsonWriter writer( out );
+        writer.reset();
+        writer.message( configName, name, type, value );
+    }
+    
+    //--------------------------------------------------------------
+    void Message::parseValue(){
+        boolValue   = false;
+        rangeValue  = 0;
+        doubleValue = 0;
+        floatArrayValue.clear();
+        
+        if ( type == TYPE_STRING ){
+            valueType = VALUE_STRING;
+        } else if ( type == TYPE_BOOLEAN ){
+            valueType   = VALUE_BOOLEAN;
+            boolValue   = ( value == "true" );
+            doubleValue = boolValue ? 1 : 0;
+        } else if ( type == TYPE_RANGE ){
+            valueType = VALUE_RANGE;
+            if ( parseNumber( value, doubleValue ) ){
+                rangeValue = (int) ci::math<double>::clamp( doubleValue, 0, 1023 );
+            }
+        } else if ( type == TYPE_FLOAT_ARRAY ){
+            valueType = VALUE_FLOAT_ARRAY;
+            parseFloatArray( value, floatArrayValue );
+        } else if ( parseNumber( value, doubleValue ) ){
+            valueType = VALUE_DOUBLE;
+        } else if ( !value.empty() && value[0] == '[' && parseFloatArray( value, floatArrayValue ) ){
+            valueType = VALUE_FLOAT_ARRAY;
         } else {
-            return "{\"message\":{\"clientName\":\"" + configName +"\",\"name\":\"" + name + "\",\"type\":\"" + type + "\",\"value\":" + value +"}}";
+            valueType = VALUE_CUSTOM;
         }
     }
     
     //--------------------------------------------------------------
-    bool Message::valueBoolean(){
-        if ( type != "boolean" ) console() << "This Message is not a boolean type! You'll most likely get 'false'" << endl;;
-        return value == "true";
+    void Message::setValue( const string & _value ){
+        value = _value;
+        parseValue();
+    }
+    
+    //--------------------------------------------------------------
+    void Message::setValue( int _value ){
+        char buf[ 24 ];
+        value.assign( buf, JsonWriter::formatInt( _value, buf ) );
+        parseValue();
     }
     
     //--------------------------------------------------------------
-    int Message::valueRange(){
-        if ( type != "range" ) console() << "This Message is not a range type! Results may be unpredictable" << endl;
-        return ci::math<int>::clamp( fromString<int>(value), 0, 1023);
+    void Message::setValue( bool _value ){
+        value = _value ? "true" : "false";
+        parseValue();
     }
     
     //--------------------------------------------------------------
-    string Message::valueString(){
-        if ( type != "string" ) console() << "This Message is not a string type! Returning raw value as string." << endl;
+    void Message::setValue( const float * values, size_t count ){
+        JsonWriter writer( value );
+        writer.reset();
+        writer.floatArray( values, count );
+        parseValue();
+    }
+    
+    //--------------------------------------------------------------
+    bool Message::valueBoolean() const {
+        if ( valueType != VALUE_BOOLEAN ) SPACEBREW_LOG_WARNING( "This Message is not a boolean type! You'll most likely get 'false'" );
+        return boolValue;
+    }
+    
+    //--------------------------------------------------------------
+    int Message::valueRange() const {
+        if ( valueType != VALUE_RANGE ) SPACEBREW_LOG_WARNING( "This Message is not a range type! Results may be unpredictable" );
+        return rangeValue;
+    }
+    
+    //--------------------------------------------------------------
+    double Message::valueDouble() const {
+        if ( valueType != VALUE_RANGE && valueType != VALUE_DOUBLE ) SPACEBREW_LOG_WARNING( "This Message is not a numeric type! Results may be unpredictable" );
+        return doubleValue;
+    }
+    
+    //--------------------------------------------------------------
+    const vector<float> & Message::valueFloatArray() const {
+        if ( valueType != VALUE_FLOAT_ARRAY ) SPACEBREW_LOG_WARNING( "This Message is not a float array! Returning an empty array." );
+        return floatArrayValue;
+    }
+    
+    //--------------------------------------------------------------
+    const string & Message::valueString() const {
+        if ( valueType != VALUE_STRING ) SPACEBREW_LOG_WARNING( "This Message is not a string type! Returning raw value as string." );
         return value;
     }
     
+#pragma mark MessageView
+    
+    //--------------------------------------------------------------
+    bool MessageView::valueBoolean() const {
+        return value == StringRef( "true", 4 );
+    }
+    
+    //--------------------------------------------------------------
+    int MessageView::valueRange() const {
+        double d;
+        return parseNumber( value, d ) ? (int) ci::math<double>::clamp( d, 0, 1023 ) : 0;
+    }
+    
+    //--------------------------------------------------------------
+    double MessageView::valueDouble() const {
+        if ( bValueQuoted && type == StringRef( TYPE_BOOLEAN ) ){
+            return valueBoolean() ? 1 : 0;
+        }
+        double d;
+        return parseNumber( value, d ) ? d : 0;
+    }
+    
+    //--------------------------------------------------------------
+    bool MessageView::valueFloatArray( vector<float> & out ) const {
+        return parseFloatArray( value, out );
+    }
+    
+    //--------------------------------------------------------------
+    Message MessageView::toMessage() const {
+        Message m;
+        toMessage( m );
+        return m;
+    }
+    
+    //--------------------------------------------------------------
+    void MessageView::toMessage( Message & out ) const {
+        out.name.assign( name.data, name.size );
+        out.type.assign( type.data, type.size );
+        out.value.assign( value.data, value.size );
+        out.parseValue();
+    }
+    
+    //--------------------------------------------------------------
+    void MessageView::reset(){
+        buffer.reset();
+        clientName = name = type = value = StringRef();
+        bValueQuoted = false;
+    }
+    
 #pragma mark Config
     
+    //--------------------------------------------------------------
+    Config::Config(){
+        bDirty = true;
+    }
+    
     //--------------------------------------------------------------
     void Config::addSubscribe( string name, string type ){
         subscribe.push_back( Message(name, type) );
+        bDirty = true;
     }
     
     //--------------------------------------------------------------
     void Config::addSubscribe( Message m ){
         subscribe.push_back(m);
+        bDirty = true;
     }
 
     //--------------------------------------------------------------
     void Config::addPublish( string name, string type, string def){
         publish.push_back( Message(name, type, def) );
+        bDirty = true;
     }
     
     //--------------------------------------------------------------
     void Config::addPublish( Message m ){
         publish.push_back(m);
+        bDirty = true;
     }
     
     //--------------------------------------------------------------
-    string Config::getJSON(){
-        string message = "{\"config\": {\"name\": \"" + name +"\",\"description\":\"" + description +"\",\"publish\": {\"messages\": [";
+    const string & Config::getJSON(){
+        if ( !bDirty && name == cachedName && description == cachedDescription ){
+            return cachedJSON;
+        }
+        
+        JsonWriter writer( cachedJSON );
+        writer.reset();
+        
+        writer.raw( "{\"config\": {\"name\": " );
+        writer.quoted( name );
+        writer.raw( ",\"description\":" );
+        writer.quoted( description );
+        writer.raw( ",\"publish\": {\"messages\": [" );
         
         for (int i=0, len=publish.size(); i<len; i++){
-            message += "{\"name\":\"" + publish[i].name + "\",";
-            message += "\"type\":\"" + publish[i].type + "\",";
-            message += "\"default\":\"" + publish[i].value + "\"";
-            message += "}";
+            writer.raw( "{\"name\":" );
+            writer.quoted( publish[i].name );
+            writer.raw( ",\"type\":" );
+            writer.quoted( publish[i].type );
+            writer.raw( ",\"default\":" );
+            writer.quoted( publish[i].value );
+            writer.raw( '}' );
             if ( i+1 < len ){
-                message += ",";
+                writer.raw( ',' );
             }
         }
         
-        message += "]},\"subscribe\": {\"messages\": [";
+        writer.raw( "]},\"subscribe\": {\"messages\": [" );
         
         for (int i=0, len=subscribe.size(); i<len; i++){
-            message += "{\"name\":\"" + subscribe[i].name + "\",";
-            message += "\"type\":\"" + subscribe[i].type + "\"";
-            message += "}";
+            writer.raw( "{\"name\":" );
+            writer.quoted( subscribe[i].name );
+            writer.raw( ",\"type\":" );
+            writer.quoted( subscribe[i].type );
+            writer.raw( '}' );
             if ( i+1 < len ){
-                message += ",";
+                writer.raw( ',' );
             }
         }
         
-        message += "]}}}";
+        writer.raw( "]}}}" );
+        
+        cachedName          = name;
+        cachedDescription   = description;
+        bDirty              = false;
+        return cachedJSON;
+    }
+    
+#pragma mark Publisher
+    
+    //--------------------------------------------------------------
+    Publisher::Publisher( Connection * _connection, const string & _name, const string & _type, const PublishOptions & _options ){
+        connection  = _connection;
+        name        = _name;
+        type        = _type;
+        options     = _options;
+        bValueQuoted = JsonWriter::isQuotedType( type );
+        bPending    = false;
+        pendingSince = 0;
+        
+        tokens          = options.burst;
+        lastRefill      = nanoTime();
+        numRateDropped  = 0;
+        numRateDelayed  = 0;
+        numRoutes       = 0;
+    }
+    
+    //--------------------------------------------------------------
+    void Publisher::send( const string & value ){
+        send( value.data(), value.size() );
+    }
+    
+    //--------------------------------------------------------------
+    void Publisher::send( const char * value, size_t len ){
+        if ( connection ){
+            connection->sendPublisher( *this, value, len );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Publisher::sendRange( int value ){
+        char buf[ 24 ];
+        send( buf, JsonWriter::formatInt( value, buf ) );
+    }
+    
+    //--------------------------------------------------------------
+    void Publisher::sendBoolean( bool value ){
+        if ( value ){
+            send( "true", 4 );
+        } else {
+            send( "false", 5 );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Publisher::sendFloatArray( const float * values, size_t count ){
+        if ( connection ){
+            string & buffer = connection->valueBuffer;
+            JsonWriter writer( buffer );
+            writer.reset();
+            writer.floatArray( values, count );
+            connection->sendPublisher( *this, buffer.data(), buffer.size() );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    bool Publisher::takeToken( int64_t now ){
+        tokens      = std::min( options.burst, tokens + ( now - lastRefill ) * options.maxRate / 1e9 );
+        lastRefill  = now;
+        if ( tokens >= 1 ){
+            tokens -= 1;
+            return true;
+        }
+        return false;
+    }
+    
+    //--------------------------------------------------------------
+    void Publisher::rebuildFrame( const string & clientName ){
+        // a frame with an empty value, split around where the value goes
+        string frame;
+        JsonWriter writer( frame );
+        writer.message( clientName, name, type, "", 0 );
         
-        return message;
+        size_t split = frame.size() - 2;
+        bValueQuoted = JsonWriter::isQuotedType( type );
+        if ( bValueQuoted ){
+            split--;
+        }
+        framePrefix.assign( frame, 0, split );
+        frameSuffix.assign( frame, split, string::npos );
+        frameClientName = clientName;
     }
     
 #pragma mark Connection
@@ -103,7 +352,6 @@ namespace Spacebrew {
     //--------------------------------------------------------------
     Connection::Connection(){
         bConnected  = false;
-        bSetup      = false;
     
         mClient.addConnectCallback( &Connection::onConnect, this );
         mClient.addDisconnectCallback( &Connection::onDisconnect, this );
@@ -112,37 +360,116 @@ namespace Spacebrew {
         mClient.addPingCallback( &Connection::onPing, this );
         mClient.addReadCallback( &Connection::onRead, this );
         
-        reconnectInterval = 2000;
-        bAutoReconnect    = false;
-    }
-    
-    void Connection::setup() {
-        if( bSetup ){
-            return;
-        }
+        reconnectInterval       = 2000;
+        reconnectMaxInterval    = 30000;
+        reconnectJitter         = 0.5;
+        reconnectAttempts       = 0;
+        reconnectDelay          = reconnectInterval;
+        bAutoReconnect          = false;
+        lastTimeTriedConnect    = 0;
+        random.seed( std::random_device()() ^ (unsigned)(uintptr_t) this );
+        
+        offlinePolicy           = OFFLINE_DROP;
+        maxOfflineFrames        = 1024;
+        numOfflineDropped       = 0;
+        
+        numRateDropped      = 0;
+        numRateDelayed      = 0;
+        numDelayedQueued    = 0;
+        
+        numPending          = 0;
+        numCoalescedSends   = 0;
+        coalesceInterval    = 0;
+        lastCoalesceFlush   = 0;
+        
+        configUpdateDepth       = 0;
+        bConfigUpdatePending    = false;
+        
+        bSuppressUnrouted       = false;
+        bRouteInfo              = false;
+        numUnroutedSuppressed   = 0;
+        
+        dispatchBudgetMessages  = 0;
+        dispatchBudgetNanos     = 0;
+        numDispatched           = 0;
+        dispatchStart           = 0;
+        collapseThreshold       = 0;
+        collapseFloor           = 0;
+        maxCarryOverDepth       = 0;
+        numCollapsed            = 0;
         
-        ci::app::App::get()->getSignalUpdate().connect( boost::bind( &Connection::update, this ) );
+        instrumentation     = NULL;
+        bInstrumented       = false;
+        recorder            = NULL;
         
-        bSetup = true;
+        bThreaded           = false;
+        bThreadRunning      = false;
+        pool                = NULL;
+        idleSleepMicros     = 500;
+        numDroppedWrites    = 0;
+        numDroppedReads     = 0;
+        for ( size_t i = 0; i < NUM_LANES; i++ ){
+            laneBudget[i]   = 0;
+            laneWritten[i]  = 0;
+        }
     }
-
+    
     //--------------------------------------------------------------
     Connection::~Connection(){
         bConnected = false;
         bAutoReconnect = false;
         
+        // after this the client belongs to this thread again
+        stopThread();
+        if ( pool ){
+            pool->remove( this );
+        }
+        
+        for ( size_t i = 0; i < publishers.size(); i++ ){
+            publishers[i]->connection = NULL;
+        }
+        
         mClient.disconnect();
         
-        ci::app::App::get()->getSignalUpdate().disconnect( boost::bind( &Connection::update, this ) );
+        delete instrumentation.load();
     }
     
     //--------------------------------------------------------------
     void Connection::update(){
-        mClient.poll();        
+        numDispatched = 0;
+        dispatchStart = dispatchBudgetNanos > 0 ? nanoTime() : 0;
+        if ( !carryOver.empty() ){
+            dispatchCarryOver();
+        }
+        
+        if ( bThreaded ){
+            processEvents();
+        } else {
+            flushLanes();
+            mClient.poll();
+        }
+        
+        if ( numPending > 0 ){
+            int now = getElapsedMillis();
+            if ( coalesceInterval <= 0 || now - lastCoalesceFlush >= coalesceInterval ){
+                lastCoalesceFlush = now;
+                flushCoalesced();
+            }
+        }
+        
+        if ( numDelayedQueued > 0 ){
+            flushDelayed();
+        }
+        
+        if ( bConnected && !offlineFrames.empty() ){
+            flushOffline();
+        }
 
         if ( bAutoReconnect ){
-            if ( !bConnected && getElapsedSeconds() * 1000 - lastTimeTriedConnect > reconnectInterval ){
-                lastTimeTriedConnect = getElapsedSeconds() * 1000;
+            if ( !bConnected && getElapsedMillis() - lastTimeTriedConnect > reconnectDelay ){
+                lastTimeTriedConnect = getElapsedMillis();
+                reconnectAttempts++;
+                reconnectDelay = nextReconnectDelay();
                 connect( host, config );
             }
         }
@@ -150,86 +477,266 @@ namespace Spacebrew {
 
     //--------------------------------------------------------------
     void Connection::connect( string _host, string name, string description){
-        setup();
-        
         host = _host;
         config.name = name;
         config.description = description;
 //        string addr = "ws://" + host + ":" + toString(SPACEBREW_PORT);
-        mClient.connect( host );
+        clientConnect( host );
     }
     
     //--------------------------------------------------------------
     void Connection::connect( string host, Config _config ){
-        setup();
-        
         config = _config;
+        for ( size_t i = 0; i < config.getSubscribe().size(); i++ ){
+            getSubscriptionSignal( config.getSubscribe()[i].name );
+            stateCache.add( config.getSubscribe()[i].name, config.getSubscribe()[i].type );
+        }
 //        string addr = "ws://" + host + ":" + toString(SPACEBREW_PORT);
-        mClient.connect( host );
+        clientConnect( host );
     }
     
     //--------------------------------------------------------------
-    void Connection::send( string name, string type, string value ){
-        if ( bConnected ){
-            Message m( name, type, value);
-			send(m);
-        } else {
-            console() << "Send failed, not connected!" << endl;
-        }
+    void Connection::send( const string & name, const string & type, const string & value ){
+        sendFrame( name, type, value.data(), value.size() );
     }
 
     //--------------------------------------------------------------
-    void Connection::sendString( string name, string value ){
-        if ( bConnected ){
-            Message m( name, "string", value);
-            send(m);
-        } else {
-            console() <<  "Send failed, not connected!" << endl;
-        }
+    void Connection::sendString( const string & name, const string & value ){
+        sendFrame( name, TYPE_STRING, value.data(), value.size() );
     }
 
     //--------------------------------------------------------------
-    void Connection::sendRange( string name, int value ){
-        if ( bConnected ){
-            Message m( name, "range", toString( value ) );
-            send(m);
-        } else {
-            console() << "Send failed, not connected!" << endl;
-        }
+    void Connection::sendRange( const string & name, int value ){
+        char buf[ 24 ];
+        size_t len = JsonWriter::formatInt( value, buf );
+        sendFrame( name, TYPE_RANGE, buf, len );
     }
 
     //--------------------------------------------------------------
-    void Connection::sendBoolean( string name, bool value ){
-        if ( bConnected ){
-            string out = value ? "true" : "false";
-            Message m( name, "boolean", out);
-            send(m);
+    void Connection::sendBoolean( const string & name, bool value ){
+        if ( value ){
+            sendFrame( name, TYPE_BOOLEAN, "true", 4 );
         } else {
-            console() << "Send failed, not connected!" << endl;
+            sendFrame( name, TYPE_BOOLEAN, "false", 5 );
         }
     }
 
+    //--------------------------------------------------------------
+    void Connection::sendFloatArray( const string & name, const float * values, size_t count ){
+        JsonWriter writer( valueBuffer );
+        writer.reset();
+        writer.floatArray( values, count );
+        sendFrame( name, TYPE_FLOAT_ARRAY, valueBuffer.data(), valueBuffer.size() );
+    }
+    
     //--------------------------------------------------------------
     void Connection::send( Message m ){
-		if ( bConnected ){
-            mClient.write( m.getJSON( config.name ) );
-        } else {
-            console() << "Send failed, not connected!" << endl;
-        }
+        // a copy is always a plain Message, so the frame can go straight into outBuffer
+        sendMessage( m, false );
 	}
 
     //--------------------------------------------------------------
     void Connection::send( Message * m ){
+        // may be a subclass with its own getJSON
+        sendMessage( *m, true );
+	}
+    
+    //--------------------------------------------------------------
+    void Connection::sendMessage( Message & m, bool bVirtualJSON ){
+        if ( isUnrouted( m.name ) ){
+            numUnroutedSuppressed++;
+            return;
+        }
+        if ( bufferOffline( m.name, m.type, m.value.data(), m.value.size() ) ){
+            return;
+        }
 		if ( bConnected ){
-            mClient.write( m->getJSON( config.name ) );
+            if ( bVirtualJSON ){
+                writeFrame( m.getJSON( config.name ), LANE_BULK );
+            } else {
+                m.writeJSON( outBuffer, config.name );
+                writeFrame( outBuffer, LANE_BULK );
+            }
         } else {
-            console() << "Send failed, not connected!" << endl;
+            SPACEBREW_LOG_WARNING( "Send failed, not connected!" );
         }
 	}
     
+    //--------------------------------------------------------------
+    void Connection::sendFrame( const string & name, const string & type, const char * value, size_t len ){
+        if ( !publishers.empty() ){
+            unordered_map<string, size_t>::iterator it = publisherIndex.find( name );
+            if ( it != publisherIndex.end() && publishers[ it->second ]->type == type ){
+                sendPublisher( *publishers[ it->second ], value, len );
+                return;
+            }
+        }
+        
+        if ( isUnrouted( name ) ){
+            numUnroutedSuppressed++;
+            return;
+        }
+        if ( bufferOffline( name, type, value, len ) ){
+            return;
+        }
+        if ( bConnected ){
+            JsonWriter writer( outBuffer );
+            writer.reset();
+            writer.message( config.name, name, type, value, len );
+            writeFrame( outBuffer, LANE_BULK );
+        } else {
+            SPACEBREW_LOG_WARNING( "Send failed, not connected!" );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    bool Connection::bufferOffline( const string & name, const string & type, const char * value, size_t len ){
+        // once anything is buffered, later sends queue behind it
+        if ( offlinePolicy == OFFLINE_DROP || ( bConnected && offlineFrames.empty() ) ){
+            return false;
+        }
+        
+        if ( offlinePolicy == OFFLINE_LATEST_PER_PUBLISHER ){
+            for ( std::deque<OfflineFrame>::iterator it = offlineFrames.begin(); it != offlineFrames.end(); ++it ){
+                if ( it->name == name ){
+                    offlineFrames.erase( it );
+                    numOfflineDropped++;
+                    break;
+                }
+            }
+        }
+        if ( offlineFrames.size() >= maxOfflineFrames ){
+            if ( offlineFrames.empty() ){
+                numOfflineDropped++;
+                return true;
+            }
+            offlineFrames.pop_front();
+            numOfflineDropped++;
+        }
+        
+        // kept unframed, the client name may change before we're back
+        offlineFrames.push_back( OfflineFrame() );
+        offlineFrames.back().name = name;
+        offlineFrames.back().type = type;
+        offlineFrames.back().value.assign( value, len );
+        return true;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::flushOffline(){
+        while ( bConnected && !offlineFrames.empty() ){
+            // in threaded mode don't overrun the outbound queue, the rest goes out next update()
+            if ( bThreaded && outbound[ LANE_BULK ].size() >= outbound[ LANE_BULK ].capacity() ){
+                return;
+            }
+            const OfflineFrame & f = offlineFrames.front();
+            JsonWriter writer( outBuffer );
+            writer.reset();
+            writer.message( config.name, f.name, f.type, f.value );
+            writeFrame( outBuffer, LANE_BULK );
+            offlineFrames.pop_front();
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::setOfflineBuffer( OfflinePolicy policy, size_t maxFrames ){
+        offlinePolicy       = policy;
+        maxOfflineFrames    = maxFrames;
+        while ( offlineFrames.size() > maxOfflineFrames ){
+            offlineFrames.pop_front();
+            numOfflineDropped++;
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::sendPublisher( Publisher & pub, const char * value, size_t len ){
+        if ( isUnrouted( pub ) ){
+            numUnroutedSuppressed++;
+            return;
+        }
+        if ( !bConnected && offlinePolicy == OFFLINE_DROP ){
+            SPACEBREW_LOG_WARNING( "Send failed, not connected!" );
+            return;
+        }
+        
+        bool bStage = pub.options.bCoalesce;
+        
+        // over the limit? (delayed sends stay in order, so anything queued goes first)
+        if ( !bStage && pub.isRateLimited() && ( !pub.delayed.empty() || !pub.takeToken( nanoTime() ) ) ){
+            switch ( pub.options.ratePolicy ){
+                case PublishOptions::RATE_DROP:
+                    pub.numRateDropped++;
+                    numRateDropped++;
+                    return;
+                    
+                case PublishOptions::RATE_DELAY:
+                    // maxDelayed may have been zeroed on the options directly, it still means one slot
+                    if ( !pub.delayed.empty() && pub.delayed.size() >= pub.options.maxDelayed ){
+                        pub.delayed.pop_front();
+                        pub.numRateDropped++;
+                        numRateDropped++;
+                        numDelayedQueued--;
+                    }
+                    pub.delayed.push_back( string( value, len ) );
+                    pub.numRateDelayed++;
+                    numRateDelayed++;
+                    numDelayedQueued++;
+                    return;
+                    
+                case PublishOptions::RATE_COALESCE:
+                    if ( !pub.bPending ){
+                        pub.numRateDelayed++;
+                        numRateDelayed++;
+                    }
+                    bStage = true;
+                    break;
+            }
+        }
+        
+        // stage it, the next flush only sends the latest value
+        if ( bStage ){
+            if ( pub.bPending ){
+                numCoalescedSends++;
+            } else {
+                pub.bPending        = true;
+                pub.pendingSince    = bInstrumented ? nanoTime() : 0;
+                numPending++;
+            }
+            pub.pendingValue.assign( value, len );
+            return;
+        }
+        
+        writePublisher( pub, value, len );
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::writePublisher( Publisher & pub, const char * value, size_t len, int64_t enqueueTime ){
+        if ( bufferOffline( pub.name, pub.type, value, len ) ){
+            return;
+        }
+        if ( !bConnected ){
+            SPACEBREW_LOG_WARNING( "Send failed, not connected!" );
+            return;
+        }
+        if ( pub.frameClientName != config.name ){
+            pub.rebuildFrame( config.name );
+        }
+        
+        outBuffer.assign( pub.framePrefix );
+        if ( pub.bValueQuoted ){
+            JsonWriter( outBuffer ).escaped( value, len );
+        } else {
+            outBuffer.append( value, len );
+        }
+        outBuffer.append( pub.frameSuffix );
+        writeFrame( outBuffer, LANE_BULK, enqueueTime );
+    }
+    
     //--------------------------------------------------------------
     void Connection::addSubscribe( string name, string type ){
         config.addSubscribe(name, type);
+        getSubscriptionSignal( name );
+        stateCache.add( name, type );
         if ( bConnected ){
             updatePubSub();
         }
@@ -238,27 +745,126 @@ namespace Spacebrew {
     //--------------------------------------------------------------
     void Connection::addSubscribe( Message m ){
         config.addSubscribe(m);
+        getSubscriptionSignal( m.name );
+        stateCache.add( m.name, m.type );
         if ( bConnected ){
             updatePubSub();
         }
     }
     
     //--------------------------------------------------------------
-    void Connection::addPublish( string name, string type, string def){
+    PublisherRef Connection::addPublish( string name, string type, string def, const PublishOptions & opts ){
         config.addPublish(name, type, def);
+        PublisherRef pub = registerPublisher( name, type, opts );
         if ( bConnected ){
             updatePubSub();
         }
+        return pub;
     }
     
     //--------------------------------------------------------------
-    void Connection::addPublish( Message m ){
+    PublisherRef Connection::addPublish( Message m, const PublishOptions & opts ){
         config.addPublish(m);
+        PublisherRef pub = registerPublisher( m.name, m.type, opts );
         if ( bConnected ){
             updatePubSub();
         }
+        return pub;
     }
-
+    
+    //--------------------------------------------------------------
+    PublisherRef Connection::getPublisher( const string & name ){
+        unordered_map<string, size_t>::iterator it = publisherIndex.find( name );
+        if ( it == publisherIndex.end() ){
+            return PublisherRef();
+        }
+        return publishers[ it->second ];
+    }
+    
+    //--------------------------------------------------------------
+    PublisherRef Connection::registerPublisher( const string & name, const string & type, const PublishOptions & opts ){
+        // re-adding a publisher updates it in place so existing handles stay valid
+        unordered_map<string, size_t>::iterator it = publisherIndex.find( name );
+        if ( it != publisherIndex.end() ){
+            PublisherRef & existing = publishers[ it->second ];
+            if ( existing->bPending ){
+                existing->bPending = false;
+                numPending--;
+            }
+            numDelayedQueued   -= existing->delayed.size();
+            existing->delayed.clear();
+            existing->type      = type;
+            existing->options   = opts;
+            existing->tokens    = opts.burst;
+            existing->frameClientName.clear();
+            existing->rebuildFrame( config.name );
+            return existing;
+        }
+        
+        PublisherRef pub( new Publisher( this, name, type, opts ) );
+        pub->rebuildFrame( config.name );
+        unordered_map<string, size_t>::iterator routed = routeCounts.find( name );
+        if ( routed != routeCounts.end() ){
+            pub->numRoutes = routed->second;
+        }
+        publisherIndex[ name ] = publishers.size();
+        publishers.push_back( pub );
+        return pub;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::setCoalesceInterval( int flushMillis ){
+        coalesceInterval = flushMillis;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::flushCoalesced(){
+        if ( numPending == 0 ){
+            return;
+        }
+        
+        int64_t now = nanoTime();
+        for ( size_t i = 0; i < publishers.size(); i++ ){
+            Publisher & pub = *publishers[i];
+            if ( !pub.bPending ){
+                continue;
+            }
+            
+            // rate limited: stays pending until there's a token
+            if ( pub.isRateLimited() && !pub.takeToken( now ) ){
+                if ( pub.options.ratePolicy == PublishOptions::RATE_DROP ){
+                    pub.numRateDropped++;
+                    numRateDropped++;
+                    pub.bPending = false;
+                    numPending--;
+                }
+                continue;
+            }
+            
+            pub.bPending = false;
+            numPending--;
+            
+            if ( bConnected || offlinePolicy != OFFLINE_DROP ){
+                writePublisher( pub, pub.pendingValue.data(), pub.pendingValue.size(), pub.pendingSince );
+            }
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::flushDelayed(){
+        int64_t now = nanoTime();
+        for ( size_t i = 0; i < publishers.size() && numDelayedQueued > 0; i++ ){
+            Publisher & pub = *publishers[i];
+            while ( !pub.delayed.empty() && pub.takeToken( now ) ){
+                if ( bConnected || offlinePolicy != OFFLINE_DROP ){
+                    writePublisher( pub, pub.delayed.front().data(), pub.delayed.front().size() );
+                }
+                pub.delayed.pop_front();
+                numDelayedQueued--;
+            }
+        }
+    }
+    
     //--------------------------------------------------------------
     Config * Connection::getConfig(){
         return &config;
@@ -277,6 +883,22 @@ namespace Spacebrew {
     //--------------------------------------------------------------
     void Connection::setReconnectRate( int reconnectMillis ){
         reconnectInterval = reconnectMillis;
+        reconnectDelay = reconnectInterval;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::setReconnectBackoff( int maxMillis, double jitter ){
+        reconnectMaxInterval    = maxMillis;
+        reconnectJitter         = ci::math<double>::clamp( jitter, 0, 1 );
+    }
+    
+    //--------------------------------------------------------------
+    int Connection::nextReconnectDelay(){
+        // reconnectInterval * 2^attempts, capped, then shortened by up to jitter
+        double delay = reconnectInterval * (double)( 1 << std::min( reconnectAttempts, 16 ) );
+        delay = std::min( delay, (double) std::max( reconnectMaxInterval, reconnectInterval ) );
+        delay *= 1.0 - reconnectJitter * std::uniform_real_distribution<double>( 0, 1 )( random );
+        return std::max( 1, (int) delay );
     }
 
     //--------------------------------------------------------------
@@ -285,41 +907,77 @@ namespace Spacebrew {
     }
 
     //--------------------------------------------------------------
-    void Connection::updatePubSub(){
-        mClient.write( config.getJSON() );
+    void Connection::beginConfigUpdate(){
+        configUpdateDepth++;
     }
     
     //--------------------------------------------------------------
-    string Connection::getHost(){
-        return host;
+    void Connection::commitConfigUpdate(){
+        if ( configUpdateDepth == 0 ){
+            return;
+        }
+        if ( --configUpdateDepth == 0 && bConfigUpdatePending ){
+            bConfigUpdatePending = false;
+            if ( bConnected ){
+                updatePubSub();
+            }
+        }
     }
     
     //--------------------------------------------------------------
-    void Connection::onConnect(){
-        bConnected = true;
-        updatePubSub();
-        signalOnConnect();
-    }
+    void Connection::updatePubSub(){
+        if ( configUpdateDepth > 0 ){
+            bConfigUpdatePending = true;
+            return;
+        }
+        writeFrame( config.getJSON(), LANE_CONTROL );
+    }
+    
+    //--------------------------------------------------------------
+    string Connection::getHost(){
+        return host;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::onConnect(){
+        if ( bThreaded ){
+            pushEvent( Event::EVENT_CONNECT );
+        } else {
+            handleConnect();
+        }
+    }
     
     //--------------------------------------------------------------
     void Connection::onDisconnect(){
-        bConnected = false;
-        lastTimeTriedConnect = getElapsedSeconds() * 1000;
-        signalOnDisconnect();
+        if ( bThreaded ){
+            pushEvent( Event::EVENT_DISCONNECT );
+        } else {
+            handleDisconnect();
+        }
     }
     
     void Connection::onError( std::string msg ) {
-        console() << "Error :: " << msg << endl;
-        
-        signalOnError( msg );
+        if ( bThreaded ){
+            pushEvent( Event::EVENT_ERROR, msg );
+        } else {
+            handleError( msg );
+        }
     }
     
     void Connection::onPing() {
-        signalOnPing();
+        if ( bThreaded ){
+            pushEvent( Event::EVENT_PING );
+        } else {
+            signalOnPing();
+        }
     }
     
     void Connection::onInterrupt() {
-        signalOnInterrupt();
+        if ( bThreaded ){
+            pushEvent( Event::EVENT_INTERRUPT );
+        } else {
+            signalOnInterrupt();
+        }
     }
     
     //--------------------------------------------------------------
@@ -327,14 +985,727 @@ namespace Spacebrew {
     
     //--------------------------------------------------------------
     void Connection::onRead( std::string msg ){
-        JsonTree j( msg );
+        receiveFrame( msg );
+    }
     
-        Message m;
-        m.name = j.getChild("message").getChild("name").getValue();
-        m.type = j.getChild("message").getChild("type").getValue();
-        m.value = j.getChild("message").getChild("value").getValue();
+    //--------------------------------------------------------------
+    void Connection::receiveFrame( string & msg ){
+        int64_t receiveTime = 0;
+        if ( bInstrumented ){
+            Instrumentation * stats = getInstrumentation();
+            receiveTime = nanoTime();
+            stats->messagesIn.fetch_add( 1, std::memory_order_relaxed );
+            stats->bytesIn.fetch_add( msg.size(), std::memory_order_relaxed );
+        }
+        
+        Recorder * rec = recorder.load( std::memory_order_acquire );
+        if ( rec ){
+            rec->record( RecordedFrame::DIRECTION_INBOUND, msg.data(), msg.size(), receiveTime ? receiveTime : nanoTime() );
+        }
+        
+        // the frame becomes the shared buffer without a copy. A buffer some listener kept a view of
+        // is left to it; otherwise the last one is recycled
+        if ( readBuffer.use_count() == 1 ){
+            std::atomic_thread_fence( std::memory_order_acquire );
+        } else {
+            readBuffer = std::make_shared<string>();
+        }
+        readBuffer->swap( msg );
+        string & data = *readBuffer;
+        
+        // parsed on whichever thread polls the client; in threaded mode that's the socket thread
+        // and the view is handed over in ioEvent
+        MessageView & view = bThreaded ? ioEvent.message : appEvent.message;
+        MessageFrame frame;
+        
+        // fast path for the plain {"message":{...}} envelope, JsonTree for everything else. The
+        // fallback packs the fields it extracts into the buffer, so the view looks the same either way
+        if ( !parseMessageFrame( &data[0], data.size(), frame ) ){
+            // may run on the socket thread, where an exception would end the program
+            try {
+                JsonTree j( data );
+                
+                // admin channel traffic (route lists), only asked for by setSuppressUnrouted
+                if ( bSuppressUnrouted && !j.hasChild("message") ){
+                    if ( bThreaded ){
+                        pushEvent( Event::EVENT_ADMIN, data );
+                    } else {
+                        handleAdmin( data );
+                    }
+                    return;
+                }
+                
+                const JsonTree & message = j.getChild("message");
+                
+                string client   = message.hasChild("clientName") ? message.getChild("clientName").getValue() : "";
+                string name     = message.getChild("name").getValue();
+                string type     = message.getChild("type").getValue();
+                
+                // the fast path turned down nested objects and arrays of strings, so those are what
+                // mostly ends up here; getValue() only holds scalars
+                const JsonTree & v  = message.getChild("value");
+                bool bScalar        = v.getNodeType() == JsonTree::NODE_VALUE;
+                string value        = bScalar ? v.getValue() : v.serialize();
+                
+                data = client + name + type + value;
+                const char * p      = data.data();
+                frame.clientName    = StringRef( p, client.size() );
+                frame.name          = StringRef( p += client.size(), name.size() );
+                frame.type          = StringRef( p += name.size(), type.size() );
+                frame.value         = StringRef( p += type.size(), value.size() );
+                frame.bValueQuoted  = bScalar && JsonWriter::isQuotedType( type );
+            } catch ( JsonTree::Exception & ){
+                SPACEBREW_LOG_WARNING( "Dropped unreadable frame: " << data );
+                return;
+            }
+        }
+        
+        view.buffer         = readBuffer;
+        view.clientName     = frame.clientName;
+        view.name           = frame.name;
+        view.type           = frame.type;
+        view.value          = frame.value;
+        view.bValueQuoted   = frame.bValueQuoted;
+        
+        if ( stateCache.size() > 0 ){
+            stateCache.set( view.name, view.value );
+        }
+        
+        if ( bThreaded ){
+            ioEvent.timestamp = receiveTime;
+            pushEvent( Event::EVENT_MESSAGE );
+        } else {
+            dispatchMessage( view, receiveTime );
+            view.reset();
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::handleConnect(){
+        bConnected          = true;
+        reconnectAttempts   = 0;
+        updatePubSub();
+        if ( bSuppressUnrouted ){
+            // admin without message copies: the server sends the current routes, then every change
+            writeFrame( "{\"admin\":[{\"admin\":true,\"no_msgs\":true}]}", LANE_CONTROL );
+        }
+        flushOffline();
+        signalOnConnect();
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::handleDisconnect(){
+        bConnected = false;
+        clearRoutes();
+        lastTimeTriedConnect = getElapsedMillis();
+        reconnectDelay = nextReconnectDelay();
+        signalOnDisconnect();
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::handleError( const string & msg ){
+        SPACEBREW_LOG_ERROR( "Error :: " << msg );
+        
+        signalOnError( msg );
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::handleMessage( const MessageView & view, int64_t receiveTime ){
+        Instrumentation * stats = NULL;
+        int64_t dispatchTime    = 0;
+        if ( bInstrumented ){
+            stats           = getInstrumentation();
+            dispatchTime    = nanoTime();
+            if ( receiveTime ){
+                stats->receiveToDispatch.record( dispatchTime - receiveTime );
+            }
+        }
+        
+        signalOnMessageView( view );
         
-        signalOnMessage( m );
+        std::shared_ptr<MessageSignal> legacySignal;
+        if ( !subscriptionSignals.empty() || !subscriptionViewSignals.empty() ){
+            lookupName.assign( view.name.data, view.name.size );
+            
+            unordered_map< string, std::shared_ptr<MessageViewSignal> >::iterator vit = subscriptionViewSignals.find( lookupName );
+            if ( vit != subscriptionViewSignals.end() && !vit->second->empty() ){
+                (*vit->second)( view );
+            }
+            
+            unordered_map< string, std::shared_ptr<MessageSignal> >::iterator it = subscriptionSignals.find( lookupName );
+            if ( it != subscriptionSignals.end() && !it->second->empty() ){
+                legacySignal = it->second;
+            }
+        }
+        
+        // Message listeners get their own copy, only made if there are any
+        if ( legacySignal || !signalOnMessage.empty() ){
+            view.toMessage( legacyMessage );
+            signalOnMessage( legacyMessage );
+            if ( legacySignal ){
+                (*legacySignal)( legacyMessage );
+            }
+        }
+        
+        if ( stats ){
+            stats->dispatch.record( nanoTime() - dispatchTime );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    boost::signals2::connection Connection::onMessage( const string & name, const std::function<void(Message)> & callback ){
+        return getSubscriptionSignal( name ).connect( callback );
+    }
+    
+    //--------------------------------------------------------------
+    const LatestValue * Connection::getLatest( const string & name ) const {
+        return stateCache.find( StringRef( name ) );
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::setDispatchBudget( size_t maxMessages, int maxMicros ){
+        dispatchBudgetMessages  = maxMessages;
+        dispatchBudgetNanos     = maxMicros > 0 ? (int64_t) maxMicros * 1000 : 0;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::setCollapseThreshold( size_t backlog ){
+        collapseThreshold = backlog;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::dispatchMessage( const MessageView & view, int64_t receiveTime ){
+        // anything already waiting goes first, so once a message is carried over so is everything after it
+        if ( carryOver.empty() && hasDispatchBudget() ){
+            handleMessage( view, receiveTime );
+            numDispatched++;
+            return;
+        }
+        
+        CarriedMessage c;
+        c.message       = view;
+        c.receiveTime   = receiveTime;
+        carryOver.push_back( c );
+        maxCarryOverDepth = std::max( maxCarryOverDepth, carryOver.size() );
+        
+        if ( collapseThreshold > 0 && carryOver.size() > std::max( collapseThreshold, collapseFloor ) ){
+            collapseCarryOver();
+        }
+    }
+    
+    //--------------------------------------------------------------
+    bool Connection::hasDispatchBudget(){
+        if ( dispatchBudgetMessages > 0 && numDispatched >= dispatchBudgetMessages ){
+            return false;
+        }
+        // always let one through, or a single slow handler would stall the queue for good
+        if ( dispatchBudgetNanos > 0 && numDispatched > 0 && nanoTime() - dispatchStart >= dispatchBudgetNanos ){
+            return false;
+        }
+        return true;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::dispatchCarryOver(){
+        while ( !carryOver.empty() && hasDispatchBudget() ){
+            handleMessage( carryOver.front().message, carryOver.front().receiveTime );
+            numDispatched++;
+            carryOver.pop_front();
+        }
+        if ( carryOver.empty() ){
+            collapseFloor = 0;
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::collapseCarryOver(){
+        // newest first, keeping the first message seen per subscription; survivors stay in arrival order
+        std::deque<CarriedMessage> kept;
+        collapseNames.clear();
+        for ( std::deque<CarriedMessage>::reverse_iterator it = carryOver.rbegin(); it != carryOver.rend(); ++it ){
+            lookupName.assign( it->message.name.data, it->message.name.size );
+            if ( collapseNames.insert( lookupName ).second ){
+                kept.push_front( *it );
+            }
+        }
+        numCollapsed += carryOver.size() - kept.size();
+        carryOver.swap( kept );
+        collapseFloor = carryOver.size() * 2;
+    }
+    
+    //--------------------------------------------------------------
+    DelegateHandle Connection::onMessageView( const string & name, const std::function<void(const MessageView &)> & callback ){
+        std::shared_ptr<MessageViewSignal> & sig = subscriptionViewSignals[ name ];
+        if ( !sig ){
+            sig = std::make_shared<MessageViewSignal>();
+        }
+        return sig->connect( callback );
+    }
+    
+    //--------------------------------------------------------------
+    Connection::MessageSignal & Connection::getSubscriptionSignal( const string & name ){
+        std::shared_ptr<MessageSignal> & sig = subscriptionSignals[ name ];
+        if ( !sig ){
+            sig = std::make_shared<MessageSignal>();
+        }
+        return *sig;
+    }
+    
+#pragma mark Routes
+    
+    //--------------------------------------------------------------
+    void Connection::setSuppressUnrouted( bool bSuppress ){
+        bSuppressUnrouted = bSuppress;
+        if ( !bSuppress ){
+            clearRoutes();
+        }
+    }
+    
+    //--------------------------------------------------------------
+    size_t Connection::getNumRoutes( const string & publisherName ) const {
+        unordered_map<string, size_t>::const_iterator it = routeCounts.find( publisherName );
+        return it == routeCounts.end() ? 0 : it->second;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::handleAdmin( const string & frame ){
+        try {
+            JsonTree j( frame );
+            
+            // the first frame after joining is the whole state: every client's config and every route
+            if ( j.getNodeType() == JsonTree::NODE_ARRAY ){
+                clearRoutes();
+                bRouteInfo = true;
+                for ( JsonTree::ConstIter it = j.begin(); it != j.end(); ++it ){
+                    if ( it->hasChild( "route" ) ){
+                        applyRoute( it->getChild( "route" ) );
+                    }
+                }
+            } else if ( j.hasChild( "route" ) ){
+                bRouteInfo = true;
+                applyRoute( j.getChild( "route" ) );
+            } else if ( j.hasChild( "remove" ) ){
+                // clients that left take their routes with them
+                const JsonTree & list = j.getChild( "remove" );
+                for ( JsonTree::ConstIter it = list.begin(); it != list.end(); ++it ){
+                    string client = it->getChild( "name" ).getValue();
+                    vector<string> gone;
+                    for ( unordered_set<string>::iterator r = routeKeys.begin(); r != routeKeys.end(); ++r ){
+                        size_t a = r->find( '\n' );
+                        size_t b = r->find( '\n', a + 1 );
+                        if ( r->compare( a + 1, b - a - 1, client ) == 0 ){
+                            gone.push_back( *r );
+                        }
+                    }
+                    for ( size_t i = 0; i < gone.size(); i++ ){
+                        size_t a = gone[i].find( '\n' );
+                        size_t b = gone[i].find( '\n', a + 1 );
+                        updateRoute( false, gone[i].substr( 0, a ), client, gone[i].substr( b + 1 ) );
+                    }
+                }
+            }
+        } catch ( ... ){
+            SPACEBREW_LOG_WARNING( "Couldn't read admin frame: " << frame );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::applyRoute( const JsonTree & route ){
+        const JsonTree & pub = route.getChild( "publisher" );
+        if ( pub.getChild( "clientName" ).getValue() != config.name ){
+            return;
+        }
+        const JsonTree & sub = route.getChild( "subscriber" );
+        updateRoute( route.getChild( "type" ).getValue() == "add",
+                     pub.getChild( "name" ).getValue(),
+                     sub.getChild( "clientName" ).getValue(),
+                     sub.getChild( "name" ).getValue() );
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::updateRoute( bool bAdd, const string & pubName, const string & subClient, const string & subName ){
+        string key = pubName + '\n' + subClient + '\n' + subName;
+        size_t count;
+        if ( bAdd ){
+            if ( !routeKeys.insert( key ).second ){
+                return;
+            }
+            count = ++routeCounts[ pubName ];
+        } else {
+            if ( routeKeys.erase( key ) == 0 ){
+                return;
+            }
+            unordered_map<string, size_t>::iterator it = routeCounts.find( pubName );
+            count = --it->second;
+            if ( count == 0 ){
+                routeCounts.erase( it );
+            }
+        }
+        
+        unordered_map<string, size_t>::iterator it = publisherIndex.find( pubName );
+        if ( it != publisherIndex.end() ){
+            publishers[ it->second ]->numRoutes = count;
+        }
+        SPACEBREW_LOG_VERBOSE( "Route " << ( bAdd ? "added" : "removed" ) << ": " << pubName << " -> " << subClient << "/" << subName << " (" << count << " routes)" );
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::clearRoutes(){
+        routeKeys.clear();
+        routeCounts.clear();
+        for ( size_t i = 0; i < publishers.size(); i++ ){
+            publishers[i]->numRoutes = 0;
+        }
+        bRouteInfo = false;
+    }
+    
+#pragma mark Stats
+    
+    //--------------------------------------------------------------
+    void Connection::setInstrumentation( bool bEnabled ){
+        if ( bEnabled && getInstrumentation() == NULL ){
+            instrumentation.store( new Instrumentation(), std::memory_order_release );
+        }
+        bInstrumented = bEnabled;
+    }
+    
+    //--------------------------------------------------------------
+    Stats Connection::getStats(){
+        Stats s;
+        s.numCoalescedSends = numCoalescedSends;
+        s.numDroppedWrites  = numDroppedWrites;
+        s.numDroppedReads   = numDroppedReads;
+        s.numRateDropped    = numRateDropped;
+        s.numRateDelayed    = numRateDelayed;
+        s.carryOverDepth    = carryOver.size();
+        s.maxCarryOverDepth = maxCarryOverDepth;
+        s.numCollapsed      = numCollapsed;
+        s.numUnroutedSuppressed = numUnroutedSuppressed;
+        
+        Instrumentation * stats = getInstrumentation();
+        if ( stats == NULL || !bInstrumented ){
+            return s;
+        }
+        
+        s.sendToWrite           = stats->sendToWrite.snapshot();
+        s.receiveToDispatch     = stats->receiveToDispatch.snapshot();
+        s.dispatch              = stats->dispatch.snapshot();
+        s.messagesIn            = stats->messagesIn.load( std::memory_order_relaxed );
+        s.messagesOut           = stats->messagesOut.load( std::memory_order_relaxed );
+        s.bytesIn               = stats->bytesIn.load( std::memory_order_relaxed );
+        s.bytesOut              = stats->bytesOut.load( std::memory_order_relaxed );
+        s.inboundQueueDepth     = inbound.size();
+        s.outboundQueueDepth    = 0;
+        for ( size_t i = 0; i < NUM_LANES; i++ ){
+            s.outboundQueueDepth += outbound[i].size() + laneBacklog[i].size();
+        }
+        s.maxInboundQueueDepth  = stats->maxInboundQueueDepth.load( std::memory_order_relaxed );
+        s.maxOutboundQueueDepth = stats->maxOutboundQueueDepth.load( std::memory_order_relaxed );
+        
+        int64_t now     = nanoTime();
+        double seconds  = ( now - stats->lastSnapshotTime ) / 1e9;
+        if ( seconds > 0 ){
+            s.bytesInPerSecond  = ( s.bytesIn - stats->lastBytesIn ) / seconds;
+            s.bytesOutPerSecond = ( s.bytesOut - stats->lastBytesOut ) / seconds;
+        }
+        stats->lastSnapshotTime = now;
+        stats->lastBytesIn      = s.bytesIn;
+        stats->lastBytesOut     = s.bytesOut;
+        
+        return s;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::resetStats(){
+        Instrumentation * stats = getInstrumentation();
+        if ( stats == NULL ){
+            return;
+        }
+        stats->sendToWrite.reset();
+        stats->receiveToDispatch.reset();
+        stats->dispatch.reset();
+        stats->messagesIn               = 0;
+        stats->messagesOut              = 0;
+        stats->bytesIn                  = 0;
+        stats->bytesOut                 = 0;
+        stats->maxInboundQueueDepth     = 0;
+        stats->maxOutboundQueueDepth    = 0;
+        stats->lastSnapshotTime         = nanoTime();
+        stats->lastBytesIn              = 0;
+        stats->lastBytesOut             = 0;
+    }
+    
+#pragma mark Threading
+    
+    //--------------------------------------------------------------
+    void Connection::setThreaded( bool _bThreaded, size_t queueSize ){
+        if ( bThreadRunning ){
+            SPACEBREW_LOG_WARNING( "Spacebrew::Connection::setThreaded must be called before connect()" );
+            return;
+        }
+        if ( pool ){
+            pool->remove( this );
+            pool = NULL;
+        }
+        bThreaded = _bThreaded;
+        for ( size_t i = 0; i < NUM_LANES; i++ ){
+            outbound[i].resize( queueSize );
+        }
+        inbound.resize( queueSize );
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::setThreaded( ConnectionPool & _pool, size_t queueSize ){
+        if ( bThreadRunning ){
+            SPACEBREW_LOG_WARNING( "Spacebrew::Connection::setThreaded must be called before connect()" );
+            return;
+        }
+        setThreaded( true, queueSize );
+        pool = &_pool;
+        pool->add( this );
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::writeFrame( const string & frame, Lane lane, int64_t enqueueTime ){
+        Recorder * rec = recorder.load( std::memory_order_acquire );
+        if ( rec ){
+            rec->record( RecordedFrame::DIRECTION_OUTBOUND, frame.data(), frame.size(), enqueueTime ? enqueueTime : nanoTime() );
+        }
+        
+        Instrumentation * stats = NULL;
+        if ( bInstrumented ){
+            stats = getInstrumentation();
+            if ( enqueueTime == 0 ){
+                enqueueTime = nanoTime();
+            }
+        }
+        
+        if ( !bThreaded ){
+            // straight out unless this lane has spent its budget for this pass, or it or a lane
+            // before it is holding frames back
+            size_t budget   = laneBudget[ lane ].load( std::memory_order_relaxed );
+            bool bWait      = budget > 0 && laneWritten[ lane ] >= budget;
+            for ( size_t i = 0; i <= (size_t) lane && !bWait; i++ ){
+                bWait = !laneBacklog[i].empty();
+            }
+            if ( !bWait ){
+                clientWrite( frame, enqueueTime );
+                laneWritten[ lane ] += frame.size();
+                return;
+            }
+            laneBacklog[ lane ].push_back( Command() );
+            laneBacklog[ lane ].back().kind         = Command::COMMAND_WRITE;
+            laneBacklog[ lane ].back().data         = frame;
+            laneBacklog[ lane ].back().timestamp    = enqueueTime;
+            if ( stats ){
+                stats->queueDepth( stats->maxOutboundQueueDepth, laneBacklog[ lane ].size() );
+            }
+            return;
+        }
+        
+        appCommand.kind         = Command::COMMAND_WRITE;
+        appCommand.timestamp    = enqueueTime;
+        appCommand.data.assign( frame );
+        if ( !outbound[ lane ].push( appCommand ) ){
+            numDroppedWrites++;
+        } else if ( stats ){
+            stats->queueDepth( stats->maxOutboundQueueDepth, outbound[ lane ].size() );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::clientWrite( const string & frame, int64_t enqueueTime ){
+        mClient.write( frame );
+        if ( enqueueTime && bInstrumented ){
+            Instrumentation * stats = getInstrumentation();
+            if ( stats ){
+                stats->sendToWrite.record( nanoTime() - enqueueTime );
+                stats->messagesOut.fetch_add( 1, std::memory_order_relaxed );
+                stats->bytesOut.fetch_add( frame.size(), std::memory_order_relaxed );
+            }
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::flushLanes(){
+        // a new pass: lane by lane, as the socket thread does; a lane out of budget keeps the rest
+        // for the next pass. Frames sent later in this pass count against the same budget
+        for ( size_t i = 0; i < NUM_LANES; i++ ){
+            size_t budget   = laneBudget[i].load( std::memory_order_relaxed );
+            laneWritten[i]  = 0;
+            while ( !laneBacklog[i].empty() && ( budget == 0 || laneWritten[i] < budget ) ){
+                Command & c = laneBacklog[i].front();
+                clientWrite( c.data, c.timestamp );
+                laneWritten[i] += c.data.size();
+                laneBacklog[i].pop_front();
+            }
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::setLaneBudget( Lane lane, size_t bytesPerPass ){
+        laneBudget[ lane ].store( bytesPerPass, std::memory_order_relaxed );
+    }
+    
+    //--------------------------------------------------------------
+    size_t Connection::getLaneBacklog( Lane lane ) const {
+        return bThreaded ? outbound[ lane ].size() : laneBacklog[ lane ].size();
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::clientConnect( const string & _host ){
+        if ( !bThreaded ){
+            mClient.connect( _host );
+            return;
+        }
+        
+        startThread();
+        appCommand.kind         = Command::COMMAND_CONNECT;
+        appCommand.timestamp    = 0;
+        appCommand.data.assign( _host );
+        
+        // connecting isn't optional, wait for room
+        while ( !outbound[ LANE_CONTROL ].push( appCommand ) ){
+            std::this_thread::yield();
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::startThread(){
+        if ( bThreadRunning ){
+            return;
+        }
+        bThreadRunning = true;
+        if ( pool ){
+            pool->attach( this );
+        } else {
+            ioThread = std::thread( &Connection::threadedFunction, this );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::stopThread(){
+        if ( !bThreadRunning ){
+            return;
+        }
+        bThreadRunning = false;
+        if ( pool ){
+            pool->detach( this );
+        } else if ( ioThread.joinable() ){
+            ioThread.join();
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::threadedFunction(){
+        while ( bThreadRunning ){
+            if ( !serviceIO() && idleSleepMicros > 0 ){
+                std::this_thread::sleep_for( std::chrono::microseconds( idleSleepMicros ) );
+            }
+        }
+    }
+    
+    //--------------------------------------------------------------
+    bool Connection::serviceIO(){
+        bool bBusy = false;
+        
+        // one command at a time from the first lane that has one and budget left, so anything
+        // queued on an earlier lane meanwhile goes next
+        size_t written[ NUM_LANES ] = {};
+        for ( ;; ){
+            size_t lane = 0;
+            for ( ; lane < NUM_LANES; lane++ ){
+                size_t budget = laneBudget[ lane ].load( std::memory_order_relaxed );
+                if ( ( budget == 0 || written[ lane ] < budget ) && outbound[ lane ].pop( ioCommand ) ){
+                    break;
+                }
+            }
+            if ( lane == NUM_LANES ){
+                break;
+            }
+            
+            bBusy = true;
+            switch ( ioCommand.kind ){
+                case Command::COMMAND_WRITE:
+                    clientWrite( ioCommand.data, ioCommand.timestamp );
+                    written[ lane ] += ioCommand.data.size();
+                    break;
+                case Command::COMMAND_CONNECT:
+                    mClient.connect( ioCommand.data );
+                    break;
+                case Command::COMMAND_DISCONNECT:
+                    mClient.disconnect();
+                    break;
+            }
+        }
+        
+        // pooled and the app thread is behind: leave frames in the socket rather than hold up the
+        // worker's other Connections
+        if ( pool && isInboundNearlyFull() ){
+            return bBusy;
+        }
+        
+        size_t queued = inbound.size();
+        mClient.poll();
+        return bBusy || inbound.size() != queued;
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::pushEvent( Event::Kind kind, const string & text ){
+        ioEvent.kind = kind;
+        ioEvent.text.assign( text );
+        if ( kind != Event::EVENT_MESSAGE ){
+            ioEvent.timestamp = 0;
+        }
+        
+        // a pooled worker can't wait here without stalling every other Connection it services
+        if ( pool && kind == Event::EVENT_MESSAGE && isInboundNearlyFull() ){
+            numDroppedReads++;
+            return;
+        }
+        
+        // back-pressure: if the app thread falls this far behind, stop reading until it catches up
+        while ( !inbound.push( ioEvent ) ){
+            if ( !bThreadRunning ){
+                return;
+            }
+            std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+        }
+        
+        if ( bInstrumented ){
+            Instrumentation * stats = getInstrumentation();
+            stats->queueDepth( stats->maxInboundQueueDepth, inbound.size() );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void Connection::processEvents(){
+        while ( inbound.pop( appEvent ) ){
+            switch ( appEvent.kind ){
+                case Event::EVENT_MESSAGE:
+                    dispatchMessage( appEvent.message, appEvent.timestamp );
+                    appEvent.message.reset();
+                    break;
+                case Event::EVENT_CONNECT:
+                    handleConnect();
+                    break;
+                case Event::EVENT_DISCONNECT:
+                    handleDisconnect();
+                    break;
+                case Event::EVENT_ERROR:
+                    handleError( appEvent.text );
+                    break;
+                case Event::EVENT_INTERRUPT:
+                    signalOnInterrupt();
+                    break;
+                case Event::EVENT_PING:
+                    signalOnPing();
+                    break;
+                case Event::EVENT_ADMIN:
+                    handleAdmin( appEvent.text );
+                    break;
+            }
+        }
     }
     
     //--------------------------------------------------------------
@@ -9,15 +9,29 @@
 #pragma once
 
 #include "WebSocketClient.h"
+#include "ciSpacebrewJson.h"
+#include "ciSpacebrewLog.h"
+#include "ciSpacebrewRingBuffer.h"
+#include "ciSpacebrewStats.h"
+#include "ciSpacebrewConnectionPool.h"
+#include "ciSpacebrewDispatcher.h"
+#include "ciSpacebrewStateCache.h"
+#include "ciSpacebrewRecorder.h"
 
 #include "cinder/Utilities.h"
 #include "cinder/Json.h"
 #include "cinder/CinderMath.h"
 
 #include <boost/signals2.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
 
 using namespace ci;
-using namespace ci::app;
 using namespace std;
 
 namespace Spacebrew {
@@ -29,6 +43,12 @@ namespace Spacebrew {
     static const std::string    TYPE_RANGE      = "range";
     static const std::string    TYPE_BOOLEAN    = "boolean";
     
+    /**
+     * @brief Custom type for packed numeric vectors (skeletons, sensor readings), sent as a raw
+     * JSON array of numbers. See Connection::sendFloatArray and Message::valueFloatArray.
+     */
+    static const std::string    TYPE_FLOAT_ARRAY = "floatArray";
+    
     /**
      * @brief Spacebrew message
      * @class Spacebrew::Message
@@ -39,6 +59,13 @@ namespace Spacebrew {
         /** @constructor */
         Message( string _name="", string _type="", string _val="");
         virtual string getJSON( string configName );
+
+        /**
+         * @brief Write this message's frame into out (cleared first). Unlike getJSON this reuses
+         * out's capacity, so repeated calls with the same buffer don't allocate. Not virtual: custom
+         * frames come from overriding getJSON, which Connection::send( Message * ) calls.
+         */
+        void writeJSON( string & out, const string & configName ) const;
         
         /**
          * @brief Name of Message
@@ -59,27 +86,71 @@ namespace Spacebrew {
         string _default;
 
         /**
-         * @brief Current value (cast to string)
+         * @brief Current value (cast to string). If you change this directly, call parseValue()
+         * afterwards (or use setValue) so the typed accessors stay in sync.
          * @type {std::string}
          */
         string value;
     
+        /**
+         * @brief What the value was parsed as
+         */
+        enum ValueType {
+            VALUE_STRING,
+            VALUE_BOOLEAN,
+            VALUE_RANGE,
+            VALUE_DOUBLE,
+            VALUE_FLOAT_ARRAY,
+            VALUE_CUSTOM
+        };
+    
+        /**
+         * @brief Parse value according to type. Done once on construction and when a message is
+         * received, so the value* accessors below don't have to.
+         */
+        void    parseValue();
+    
+        void    setValue( const string & _value );
+        void    setValue( int _value );
+        void    setValue( bool _value );
+        void    setValue( const float * values, size_t count );
+    
+        ValueType getValueType() const { return valueType; }
+    
         /**
          * @brief Get your incoming value as a boolean
          */
-        bool    valueBoolean();
+        bool    valueBoolean() const;
     
         /**
          * @brief Get your incoming value as a range (0-1023)
          */
-        int     valueRange();
+        int     valueRange() const;
+    
+        /**
+         * @brief Get your incoming value as a number (ranges, numeric custom types)
+         */
+        double  valueDouble() const;
     
         /**
          * @brief Get your incoming value as a string
          */
-        string    valueString();
+        const string & valueString() const;
+    
+        /**
+         * @brief Get your incoming value as floats (TYPE_FLOAT_ARRAY, or any custom type whose
+         * value is a flat array of numbers)
+         */
+        const vector<float> & valueFloatArray() const;
     
         friend ostream& operator<<(ostream& os, const Message& vec);
+    
+      protected:
+        ValueType   valueType;
+        bool        boolValue;
+        int         rangeValue;
+        double      doubleValue;
+        vector<float> floatArrayValue;
     };
     
     inline ostream& operator<<(ostream& os, const Message& m) {
@@ -87,6 +158,77 @@ namespace Spacebrew {
         return os;
     }
     
+    /**
+     * @brief Received message whose fields are slices of the frame it arrived in. The frame lives in
+     * one ref-counted buffer, so handing a MessageView to any number of listeners copies nothing,
+     * and copying one (to keep it past the callback) only bumps the buffer's ref count.
+     * @example
+     * connection.signalOnMessageView.connect( []( const Spacebrew::MessageView & m ){
+     *     if ( m.getName() == StringRef( "mouseX" ) ) x = m.valueRange();
+     * });
+     * @class Spacebrew::MessageView
+     */
+    class MessageView {
+      public:
+        MessageView() : bValueQuoted( false ) {}
+    
+        const StringRef &   getClientName() const { return clientName; }
+        const StringRef &   getName() const { return name; }
+        const StringRef &   getType() const { return type; }
+    
+        /**
+         * @brief String contents for quoted values (string, boolean), raw JSON text otherwise
+         */
+        const StringRef &   getValue() const { return value; }
+        bool                isValueQuoted() const { return bValueQuoted; }
+    
+        /**
+         * @brief Typed reads, parsed from the slice on every call (no caching, no allocation)
+         */
+        bool    valueBoolean() const;
+        int     valueRange() const;
+        double  valueDouble() const;
+    
+        /**
+         * @brief Parse a flat number array value into out, reusing its capacity
+         * @return false (and out empty) if the value isn't one
+         */
+        bool    valueFloatArray( vector<float> & out ) const;
+    
+        /**
+         * @brief Copy into an owning Message. The second form reuses out's strings.
+         */
+        Message toMessage() const;
+        void    toMessage( Message & out ) const;
+    
+        /**
+         * @return The frame buffer the slices point into
+         */
+        const std::shared_ptr<const string> & getBuffer() const { return buffer; }
+    
+        /**
+         * @brief Let go of the buffer; the slices are invalid afterwards
+         */
+        void reset();
+    
+      protected:
+        friend class Connection;
+    
+        std::shared_ptr<const string>   buffer;
+        StringRef                       clientName;
+        StringRef                       name;
+        StringRef                       type;
+        StringRef                       value;
+        bool                            bValueQuoted;
+    };
+    
+    inline ostream& operator<<(ostream& os, const MessageView& m) {
+        os.write( m.getName().data, m.getName().size ) << ", ";
+        os.write( m.getType().data, m.getType().size ) << ", ";
+        os.write( m.getValue().data, m.getValue().size );
+        return os;
+    }
+    
     /**
      * @brief Wrapper for Spacebrew config message. Gets created automatically by
      * Spacebrew::Connection, but can sometimes be nice to use yourself.
@@ -100,30 +242,174 @@ namespace Spacebrew {
         // on Spacebrew::Connection directly
         void addSubscribe( string name, string type );
         void addSubscribe( Message m );
+        Config();
+        
         void addPublish( string name, string type, string def);
         void addPublish( Message m );
         
-        string getJSON();
+        /**
+         * @brief Serialized config message. Cached, and only rebuilt after the publish/subscribe lists,
+         * name or description change.
+         */
+        const string & getJSON();
         string name, description;
         
+        const vector<Message> & getPublish() const { return publish; }
+        const vector<Message> & getSubscribe() const { return subscribe; }
+        
       private:
         
         vector<Message> publish;
         vector<Message> subscribe;
+        
+        bool    bDirty;
+        string  cachedJSON;
+        string  cachedName, cachedDescription;
+    };
+    
+    /**
+     * @brief Per-publisher options, passed to Connection::addPublish
+     * @example
+     * connection.addPublish( "mouseX", TYPE_RANGE, "0", PublishOptions().coalesce() );
+     */
+    struct PublishOptions {
+        
+        /**
+         * @brief What happens to sends over the rate limit
+         */
+        enum RateLimitPolicy {
+            RATE_DROP,      // discarded (counted)
+            RATE_DELAY,     // queued, sent in order as the limit allows
+            RATE_COALESCE   // only the latest is kept and sent as soon as the limit allows
+        };
+        
+        PublishOptions() : bCoalesce( false ), maxRate( 0 ), burst( 1 ), ratePolicy( RATE_DROP ), maxDelayed( 64 ) {}
+        
+        /**
+         * @brief Only send the latest value per flush (see Connection::setCoalesceInterval)
+         * instead of one frame per send call
+         */
+        PublishOptions & coalesce( bool _bCoalesce = true ){ bCoalesce = _bCoalesce; return *this; }
+        
+        /**
+         * @brief Cap this publisher with a token bucket
+         * @param {double} messagesPerSecond    Sustained rate, 0 for no limit
+         * @param {double} _burst               How many messages can go out back to back
+         * @param {RateLimitPolicy} policy      What to do with sends over the limit
+         * @param {size_t} _maxDelayed          RATE_DELAY only: queue length before the oldest is dropped. At
+         *                                      least 1; 0 is treated as 1, so only the newest delayed send is kept
+         */
+        PublishOptions & rateLimit( double messagesPerSecond, double _burst = 1, RateLimitPolicy policy = RATE_DROP, size_t _maxDelayed = 64 ){
+            maxRate     = messagesPerSecond;
+            burst       = _burst < 1 ? 1 : _burst;
+            ratePolicy  = policy;
+            maxDelayed  = _maxDelayed < 1 ? 1 : _maxDelayed;
+            return *this;
+        }
+        
+        bool                bCoalesce;
+        double              maxRate;
+        double              burst;
+        RateLimitPolicy     ratePolicy;
+        size_t              maxDelayed;
+    };
+    
+    class Connection;
+    
+    /**
+     * @brief Handle to a registered publisher, returned by Connection::addPublish. Everything in its
+     * frame except the value is serialized once and cached, so sending through the handle skips the
+     * name lookup and only formats the value.
+     * @class Spacebrew::Publisher
+     */
+    class Publisher {
+      public:
+        Publisher( Connection * _connection, const string & _name, const string & _type, const PublishOptions & _options );
+    
+        /**
+         * @brief Send a value (cast to string; raw JSON for custom types)
+         */
+        void send( const string & value );
+        void send( const char * value, size_t len );
+    
+        void sendString( const string & value ){ send( value ); }
+        void sendRange( int value );
+        void sendBoolean( bool value );
+        void sendFloatArray( const float * values, size_t count );
+    
+        const string &          getName() const { return name; }
+        const string &          getType() const { return type; }
+        const PublishOptions &  getOptions() const { return options; }
+    
+        /**
+         * @return false once the Connection that created this handle is gone
+         */
+        bool isValid() const { return connection != NULL; }
+    
+        /**
+         * @return Sends dropped / delayed by this publisher's rate limit
+         */
+        size_t getNumRateDropped() const { return numRateDropped; }
+        size_t getNumRateDelayed() const { return numRateDelayed; }
+    
+        /**
+         * @return Subscribers routed to this publisher, as last reported by the server's admin channel
+         * (see Connection::setSuppressUnrouted; 0 if route tracking is off)
+         */
+        size_t getNumRoutes() const { return numRoutes; }
+    
+      protected:
+        friend class Connection;
+    
+        /**
+         * @brief Re-serialize prefix/suffix for a new client name
+         */
+        void rebuildFrame( const string & clientName );
+    
+        Connection *    connection;
+        string          name;
+        string          type;
+        PublishOptions  options;
+    
+        // {"message":{"clientName":"..","name":"..","type":"..","value":  +  value  +  }}
+        string          framePrefix;
+        string          frameSuffix;
+        string          frameClientName;
+    
+        bool            bValueQuoted;
+    
+        // coalescing
+        bool            bPending;
+        string          pendingValue;
+        int64_t         pendingSince;
+    
+        // rate limiting
+        bool            takeToken( int64_t now );
+        bool            isRateLimited() const { return options.maxRate > 0; }
+    
+        double          tokens;
+        int64_t         lastRefill;
+        std::deque<string> delayed;
+        size_t          numRateDropped;
+        size_t          numRateDelayed;
+    
+        // route tracking
+        size_t          numRoutes;
     };
     
+    typedef std::shared_ptr<Publisher> PublisherRef;
+    
     /**
      * @brief Main Spacebrew class, connected to Spacebrew server. Sets up socket, builds configs
-     * and publishes ofEvents on incoming messages.
+     * and publishes ofEvents on incoming messages. Doesn't depend on a Cinder App: call update()
+     * from your own loop, use setThreaded(), or use Spacebrew::AppConnection (ciSpacebrewApp.h)
+     * to have it driven by the App's update signal.
      * @class Spacebrew::Connection
      */
     class Connection {
       public:
         Connection();
-        ~Connection();
-    
-        void setup();
-        bool bSetup;
+        virtual ~Connection();
     
         /**
          * @brief Connect to Spacebrew. Pass empty values to connect to default host as "openFrameworks" app 
@@ -141,28 +427,36 @@ namespace Spacebrew {
          * @param {std::string} type    Message type ("string", "boolean", "range", or custom type)
          * @param {std::string} value   Value (cast to string)
          */
-        void send( string name, string type, string value );
+        void send( const string & name, const string & type, const string & value );
 
         /**
          * @brief Send a string message
          * @param {std::string} name    Name of message
          * @param {std::string} value   Value
          */
-        void sendString( string name, string value );
+        void sendString( const string & name, const string & value );
 
         /**
          * @brief Send a range message
          * @param {std::string} name    Name of message
          * @param {int}         value   Value
          */
-        void sendRange( string name, int value );
+        void sendRange( const string & name, int value );
 
         /**
          * @brief Send a boolean message
          * @param {std::string} name    Name of message
          * @param {bool}        value   Value
          */
-        void sendBoolean( string name, bool value );
+        void sendBoolean( const string & name, bool value );
+
+        /**
+         * @brief Send an array of floats as TYPE_FLOAT_ARRAY
+         * @param {std::string}  name    Name of message
+         * @param {const float*} values  First element
+         * @param {size_t}       count   Number of elements
+         */
+        void sendFloatArray( const string & name, const float * values, size_t count );
 
         /**
          * Send a Spacebrew Message object
@@ -172,7 +466,8 @@ namespace Spacebrew {
 
         /**
          * @brief Send a Spacebrew Message object. Use this method if you've overridden Spacebrew::Message
-         * (especially) if you've created a custom getJson() method!)
+         * (especially) if you've created a custom getJson() method!) Messages buffered while offline
+         * (see setOfflineBuffer) are sent as plain frames.
          * @param {Spacebrew::Message} m
          */
         void send( Message * m );
@@ -192,17 +487,60 @@ namespace Spacebrew {
         
         /**
          * @brief Add message of specific name + type to publish
-         * @param {std::string} name Name of message
-         * @param {std::string} typ  Message type ("string", "boolean", "range", or custom type)
-         * @param {std::string} def  Default value
+         * @param {std::string} name                Name of message
+         * @param {std::string} typ                 Message type ("string", "boolean", "range", or custom type)
+         * @param {std::string} def                 Default value
+         * @param {Spacebrew::PublishOptions} opts  Coalescing etc.
+         * @return Handle for sending on this publisher without a name lookup
          */
-        void addPublish( string name, string type, string def="");
+        PublisherRef addPublish( string name, string type, string def="", const PublishOptions & opts = PublishOptions() );
 
         /**
          * @brief Add message to publish
          * @param {Spacebrew::Message} m
+         * @param {Spacebrew::PublishOptions} opts
+         * @return Handle for sending on this publisher without a name lookup
          */
-        void addPublish( Message m );
+        PublisherRef addPublish( Message m, const PublishOptions & opts = PublishOptions() );
+
+        /**
+         * @return Handle for a publisher added earlier, or an empty ref
+         */
+        PublisherRef getPublisher( const string & name );
+
+        /**
+         * @brief How often coalesced publishers are flushed. 0 (the default) flushes once per update()
+         * @param {int} flushMillis
+         */
+        void setCoalesceInterval( int flushMillis );
+
+        /**
+         * @return Number of sends that were replaced by a newer value before being flushed
+         */
+        size_t getNumCoalescedSends() const { return numCoalescedSends; }
+
+        /**
+         * @brief Send all staged coalesced values now. Called from update().
+         */
+        void flushCoalesced();
+
+        /**
+         * @return Sends dropped / delayed by publisher rate limits (see PublishOptions::rateLimit)
+         */
+        size_t getNumRateDropped() const { return numRateDropped; }
+        size_t getNumRateDelayed() const { return numRateDelayed; }
+
+        /**
+         * @brief Batch publish/subscribe changes. Between begin and commit, addPublish/addSubscribe only
+         * update the local config; commit sends a single config message for the whole batch.
+         * Calls can nest, the outermost commit sends.
+         * @example
+         * connection.beginConfigUpdate();
+         * for ( ... ) connection.addPublish( ... );
+         * connection.commitConfigUpdate();
+         */
+        void beginConfigUpdate();
+        void commitConfigUpdate();
 
         /**
          * @return Current Spacebrew::Config (list of publish/subscribe, etc)
@@ -221,10 +559,65 @@ namespace Spacebrew {
         void setAutoReconnect( bool bAutoReconnect=true );
 
         /**
-         * @brief How often should we try to reconnect if auto-reconnect is on (defaults to 1 second [1000 millis])
+         * @brief How long to wait before the first reconnect attempt if auto-reconnect is on (defaults to 2 seconds
+         * [2000 millis]). Each failed attempt doubles the wait, up to setReconnectBackoff's maximum.
          * @param {int} reconnectMillis How often to reconnect, in milliseconds
          */
         void setReconnectRate( int reconnectMillis );
+    
+        /**
+         * @brief Shape the reconnect backoff. Every wait is shortened by a random fraction of up to jitter, so a
+         * fleet of clients that lost the same server doesn't come back all at once.
+         * @param {int} maxMillis       Longest wait between attempts (default 30000; same as the reconnect rate for a fixed interval)
+         * @param {double} jitter       0 - 1 (default 0.5; 0 for none)
+         */
+        void setReconnectBackoff( int maxMillis, double jitter = 0.5 );
+    
+        /**
+         * @brief What happens to sends while not connected
+         */
+        enum OfflinePolicy {
+            OFFLINE_DROP,                   // dropped (default)
+            OFFLINE_DROP_OLDEST,            // buffered; when full the oldest frame is dropped
+            OFFLINE_LATEST_PER_PUBLISHER    // buffered, but only the latest frame per message name is kept
+        };
+    
+        /**
+         * @brief Buffer sends made while disconnected and send them, in order, once connected again
+         * (right after the config). Sends made while the buffer is still draining queue up behind it.
+         * @param {OfflinePolicy} policy
+         * @param {size_t} maxFrames    Buffer size, in frames
+         */
+        void setOfflineBuffer( OfflinePolicy policy, size_t maxFrames = 1024 );
+    
+        /**
+         * @return Frames waiting for a connection / dropped from the offline buffer
+         */
+        size_t getNumOfflineBuffered() const { return offlineFrames.size(); }
+        size_t getNumOfflineDropped() const { return numOfflineDropped; }
+    
+        /**
+         * @brief Join the server's admin channel to follow the routes to this client's publishers, and
+         * skip sends on publishers that nobody is routed to. Sending resumes as soon as a route is added.
+         * Until the server has sent its route list everything is sent as usual. Call before connect().
+         * @param {bool} bSuppress
+         */
+        void setSuppressUnrouted( bool bSuppress = true );
+    
+        /**
+         * @return Sends skipped because their publisher had no routes
+         */
+        size_t getNumUnroutedSuppressed() const { return numUnroutedSuppressed; }
+    
+        /**
+         * @return Has the server told us about routes yet (see setSuppressUnrouted)?
+         */
+        bool hasRouteInfo() const { return bRouteInfo; }
+    
+        /**
+         * @return Subscribers routed to one of our publishers
+         */
+        size_t getNumRoutes( const string & publisherName ) const;
 
         /**
          * @return Are we trying to auto-reconnect?
@@ -236,6 +629,97 @@ namespace Spacebrew {
          */
         string getHost();
     
+        /**
+         * @brief Run the socket on a background thread. The thread polls the WebSocketClient continuously,
+         * parses incoming frames and queues them for update(), which still fires every signal on the
+         * calling (app) thread. Outgoing frames are queued to the thread the same way.
+         * Call before connect().
+         * @param {bool} bThreaded
+         * @param {size_t} queueSize Capacity of each queue (inbound, and one per outbound Lane)
+         */
+        void setThreaded( bool bThreaded = true, size_t queueSize = 4096 );
+    
+        /**
+         * @brief Threaded mode, but serviced by one of pool's worker threads instead of a thread of
+         * its own (see ConnectionPool). The smaller default queues keep per-Connection memory low when
+         * running hundreds of clients. A worker never waits on one Connection: while its inbound
+         * queue is (nearly) full the socket isn't read, and messages that still don't fit are dropped
+         * (see getNumDroppedReads). Call before connect().
+         * @param {ConnectionPool} pool
+         * @param {size_t} queueSize Capacity of each queue (inbound, and one per outbound Lane)
+         */
+        void setThreaded( ConnectionPool & pool, size_t queueSize = 32 );
+    
+        /**
+         * @return Is the socket serviced by a background thread?
+         */
+        bool isThreaded() const { return bThreaded; }
+    
+        /**
+         * @brief How long the background thread sleeps when a poll found nothing to do (default 500 micros)
+         */
+        void setIdleSleep( int micros ){ idleSleepMicros = micros; }
+    
+        /**
+         * @return Outgoing frames dropped because the outbound queue was full (threaded mode)
+         */
+        size_t getNumDroppedWrites() const { return numDroppedWrites; }
+    
+        /**
+         * @return Incoming messages dropped because the inbound queue was full (pooled threaded mode)
+         */
+        size_t getNumDroppedReads() const { return numDroppedReads; }
+    
+        /**
+         * @brief Outgoing frames are queued per lane. A lane is only written once every lane before
+         * it is empty, so control frames never wait behind a backlog of data.
+         */
+        enum Lane {
+            LANE_CONTROL,       // config and admin frames
+            LANE_BULK,          // publisher data
+            NUM_LANES
+        };
+    
+        /**
+         * @brief Cap the bytes a lane hands to the socket per pass: per update() unthreaded, per
+         * socket thread poll threaded. The rest waits, in order, for the next pass, and the socket is
+         * polled in between, so a lane over budget can't hold up the lanes before it for long.
+         * A pass always writes at least one frame per lane.
+         * @param {Lane} lane
+         * @param {size_t} bytesPerPass 0 for no cap (default)
+         */
+        void setLaneBudget( Lane lane, size_t bytesPerPass );
+    
+        /**
+         * @return Frames queued in a lane and not yet handed to the socket
+         */
+        size_t getLaneBacklog( Lane lane ) const;
+    
+        /**
+         * @brief Timestamp messages as they're sent, written, received and dispatched, and keep latency
+         * histograms, queue depths and byte counts for getStats(). Off by default; when off the cost is
+         * one pointer check per message. Best turned on before connect() in threaded mode.
+         */
+        void setInstrumentation( bool bEnabled = true );
+    
+        /**
+         * @return Snapshot of the counters. Latencies, message and byte counts and queue depths are only
+         * recorded while instrumentation is on (all zero when off); the drop and coalescing counters
+         * are always kept. Byte rates are averaged since the previous call, so call it on a fixed schedule.
+         */
+        Stats getStats();
+    
+        /**
+         * @brief Clear the latency histograms, message and byte counts and max queue depths
+         */
+        void resetStats();
+    
+        /**
+         * @brief Log every frame received and sent to recorder (not owned; NULL to stop). Play the
+         * log back later with Spacebrew::Replayer.
+         */
+        void setRecorder( Recorder * _recorder ){ recorder.store( _recorder, std::memory_order_release ); }
+    
         void				connect();
         void				disconnect();
     
@@ -247,9 +731,67 @@ namespace Spacebrew {
         void				onRead( std::string msg );
         void				write();
     
+        /**
+         * @brief Latest value received on a subscription, for sampling state (in draw(), on a worker
+         * thread) instead of listening for messages. Every subscription added through this Connection
+         * is tracked. Values are recorded as they're read from the socket, so they can be ahead of
+         * what the message signals have delivered (see setDispatchBudget).
+         * @param {std::string} name    Name of the subscription
+         * @return Valid for this Connection's lifetime (look it up once), or NULL if there's no
+         * such subscription. Reading it is safe from any thread.
+         */
+        const LatestValue * getLatest( const string & name ) const;
+    
+        /**
+         * @brief Longest string value kept per subscription by getLatest, in bytes (default 512).
+         * Call before adding subscriptions.
+         */
+        void setLatestStringCapacity( size_t bytes ){ stateCache.setStringCapacity( bytes ); }
+    
+        /**
+         * @brief Cap how much of the inbound backlog one update() dispatches, so a burst (say, a
+         * backlog flushed after a reconnect) is spread over several frames instead of stalling one.
+         * Messages over the budget are carried over and dispatched first thing in the next update(),
+         * in arrival order. Both limits 0 (the default) dispatches everything.
+         * @param {size_t} maxMessages  Messages per update(), 0 for no limit
+         * @param {int} maxMicros       Time per update() spent in message handlers, 0 for no limit
+         */
+        void setDispatchBudget( size_t maxMessages, int maxMicros = 0 );
+    
+        /**
+         * @brief Once more than backlog messages are carried over, drop all but the newest message
+         * of each subscription. For streams where only the latest value matters. 0 (default) never collapses.
+         * @param {size_t} backlog
+         */
+        void setCollapseThreshold( size_t backlog );
+    
+        /**
+         * @return Messages waiting for the next update() / the most that ever waited / how many
+         * were dropped by collapsing
+         */
+        size_t getCarryOverDepth() const { return carryOver.size(); }
+        size_t getMaxCarryOverDepth() const { return maxCarryOverDepth; }
+        size_t getNumCollapsed() const { return numCollapsed; }
+    
+        /**
+         * @brief Service the connection: poll the socket (or drain the socket thread's queue), fire
+         * signals, flush coalesced publishers and auto-reconnect. Call regularly from whatever loop
+         * owns this Connection.
+         */
         void                update();
     
+        /**
+         * @brief Every incoming message, copied into a Message per listener. Only built when something
+         * listens here or on onMessage; signalOnMessageView / onMessageView avoid the copies.
+         */
         boost::signals2::signal<void(Message)>  signalOnMessage;
+    
+        /**
+         * @brief Every incoming message as a view into its frame, passed to all listeners by reference.
+         * A Dispatcher rather than a boost signal: no lock or slot tracking per message, but connect
+         * and disconnect only from the thread that calls update().
+         */
+        Dispatcher<const MessageView &>         signalOnMessageView;
         boost::signals2::signal<void(void)>     signalOnConnect;
         boost::signals2::signal<void(void)>     signalOnDisconnect;
         boost::signals2::signal<void(string)>   signalOnError;
@@ -261,19 +803,235 @@ namespace Spacebrew {
             signalOnMessage.connect(std::bind(callback, callbackObject, std::placeholders::_1));
         }
     
+        /**
+         * @brief Listen for messages on a single subscription. Incoming messages are looked up by name
+         * once, so only the handlers for that subscription run. signalOnMessage still gets everything.
+         * @param {std::string} name    Name of the subscription
+         * @param {function} callback   void( Message )
+         * @return Connection you can disconnect() to stop listening
+         */
+        boost::signals2::connection onMessage( const string & name, const std::function<void(Message)> & callback );
+    
+        template<typename T, typename Y>
+        inline boost::signals2::connection addListener(const string & name, T callback, Y *callbackObject) {
+            return onMessage( name, std::bind(callback, callbackObject, std::placeholders::_1) );
+        }
+    
+        /**
+         * @brief Zero-copy onMessage: the handler gets a view into the received frame
+         * @param {std::string} name    Name of the subscription
+         * @param {function} callback   void( const MessageView & )
+         * @return Handle you can disconnect() to stop listening
+         */
+        DelegateHandle onMessageView( const string & name, const std::function<void(const MessageView &)> & callback );
+    
       protected:
         string host;
         bool bConnected;
         void updatePubSub();
+        
+        // config transactions
+        int  configUpdateDepth;
+        bool bConfigUpdatePending;
+        
+        // every outgoing frame ends up here, either written directly or queued for the socket thread
+        void writeFrame( const string & frame, Lane lane, int64_t enqueueTime = 0 );
+        void sendMessage( Message & m, bool bVirtualJSON );
+        void clientWrite( const string & frame, int64_t enqueueTime );
+        void clientConnect( const string & host );
+        void flushLanes();
+        
+        // app thread side of the client callbacks
+        void handleConnect();
+        void handleDisconnect();
+        void handleError( const string & msg );
+        void handleMessage( const MessageView & view, int64_t receiveTime = 0 );
+        void handleAdmin( const string & frame );
+        
+        // onRead without the copy: frame is swapped into the read buffer and comes back holding the
+        // previous buffer's storage, so a caller that refills it every time stops allocating
+        void receiveFrame( string & frame );
+        void sendFrame( const string & name, const string & type, const char * value, size_t len );
     
         Config config;
         
         // reconnect
+        int  nextReconnectDelay();
+    
         bool bAutoReconnect;
         int  lastTimeTriedConnect;
         int  reconnectInterval;
+        int  reconnectMaxInterval;
+        int  reconnectAttempts;
+        int  reconnectDelay;
+        double          reconnectJitter;
+        std::minstd_rand random;
+    
+        // offline buffer
+        struct OfflineFrame {
+            string  name;
+            string  type;
+            string  value;
+        };
+    
+        bool bufferOffline( const string & name, const string & type, const char * value, size_t len );
+        void flushOffline();
+        
+        // route tracking (admin channel)
+        void applyRoute( const JsonTree & route );
+        void updateRoute( bool bAdd, const string & pubName, const string & subClient, const string & subName );
+        void clearRoutes();
+        bool isUnrouted( const Publisher & pub ) const {
+            return bSuppressUnrouted && bRouteInfo && pub.numRoutes == 0;
+        }
+        bool isUnrouted( const string & name ) const {
+            return bSuppressUnrouted && bRouteInfo && routeCounts.find( name ) == routeCounts.end();
+        }
+        
+        bool                            bSuppressUnrouted;
+        bool                            bRouteInfo;
+        size_t                          numUnroutedSuppressed;
+        unordered_set<string>           routeKeys;      // "pubName\nsubClient\nsubName"
+        unordered_map<string, size_t>   routeCounts;    // per publisher name
+    
+        OfflinePolicy               offlinePolicy;
+        size_t                      maxOfflineFrames;
+        size_t                      numOfflineDropped;
+        std::deque<OfflineFrame>    offlineFrames;
     
         WebSocketClient		mClient;
+
+        // reused for every outgoing frame, see JsonWriter
+        string outBuffer;
+        
+        // reused to format typed values (float arrays) before they're framed
+        string valueBuffer;
+        
+        // every publisher, looked up by name on send
+        friend class Publisher;
+        friend class ConnectionPool;
+        friend class Replayer;
+        
+        PublisherRef registerPublisher( const string & name, const string & type, const PublishOptions & opts );
+        void sendPublisher( Publisher & pub, const char * value, size_t len );
+        void writePublisher( Publisher & pub, const char * value, size_t len, int64_t enqueueTime = 0 );
+        
+        vector<PublisherRef>            publishers;
+        unordered_map<string, size_t>   publisherIndex;
+        
+        // per-subscription handlers, keyed on subscription name
+        typedef boost::signals2::signal<void(Message)> MessageSignal;
+        typedef Dispatcher<const MessageView &> MessageViewSignal;
+        
+        MessageSignal & getSubscriptionSignal( const string & name );
+        
+        unordered_map< string, std::shared_ptr<MessageSignal> >     subscriptionSignals;
+        unordered_map< string, std::shared_ptr<MessageViewSignal> > subscriptionViewSignals;
+        
+        // latest value per subscription, written on the thread that reads the socket
+        StateCache              stateCache;
+        
+        // inbound frames: received into readBuffer (reused once no view holds on to it), then
+        // sliced into a MessageView. legacyMessage is only filled for Message listeners.
+        std::shared_ptr<string> readBuffer;
+        Message                 legacyMessage;
+        string                  lookupName;
+        
+        // threaded mode
+        struct Command {
+            enum Kind { COMMAND_WRITE, COMMAND_CONNECT, COMMAND_DISCONNECT };
+            Kind    kind;
+            string  data;
+            int64_t timestamp;
+        };
+        
+        struct Event {
+            enum Kind { EVENT_MESSAGE, EVENT_CONNECT, EVENT_DISCONNECT, EVENT_ERROR, EVENT_INTERRUPT, EVENT_PING, EVENT_ADMIN };
+            Kind        kind;
+            MessageView message;
+            string      text;
+            int64_t     timestamp;
+        };
+        
+        void startThread();
+        void stopThread();
+        void threadedFunction();
+        bool serviceIO();
+        void pushEvent( Event::Kind kind, const string & text = "" );
+        void processEvents();
+        
+        bool                bThreaded;
+        ConnectionPool *    pool;
+        std::thread         ioThread;
+        std::atomic<bool>   bThreadRunning;
+        int                 idleSleepMicros;
+        size_t              numDroppedWrites;
+        std::atomic<size_t> numDroppedReads;    // written by the socket thread
+        
+        // pooled: the last few inbound slots are kept for connect/disconnect/error events
+        bool isInboundNearlyFull() const {
+            return inbound.capacity() - inbound.size() <= std::min<size_t>( 4, inbound.capacity() / 4 );
+        }
+        
+        RingBuffer<Command> outbound[ NUM_LANES ];  // app thread -> socket thread (connect/disconnect on LANE_CONTROL)
+        RingBuffer<Event>   inbound;        // socket thread -> app thread
+        Command             appCommand;     // scratch, only touched by the app thread
+        Command             ioCommand;      // scratch, only touched by the socket thread
+        Event               ioEvent;        // scratch, only touched by the socket thread
+        Event               appEvent;       // scratch, only touched by the app thread
+        
+        // outbound lanes. Unthreaded, frames only wait in laneBacklog while their lane is over
+        // budget or a lane before it has a backlog; flushLanes() drains them from update()
+        std::atomic<size_t> laneBudget[ NUM_LANES ];
+        deque<Command>      laneBacklog[ NUM_LANES ];
+        size_t              laneWritten[ NUM_LANES ];   // bytes written this pass, unthreaded
+        
+        // instrumentation, NULL until enabled and then kept for the Connection's lifetime
+        std::atomic<Instrumentation *>  instrumentation;
+        std::atomic<bool>               bInstrumented;
+        
+        inline Instrumentation * getInstrumentation() const {
+            return instrumentation.load( std::memory_order_acquire );
+        }
+        
+        // set from the app thread, used on both
+        std::atomic<Recorder *>         recorder;
+        
+        // dispatch budget
+        struct CarriedMessage {
+            MessageView message;
+            int64_t     receiveTime;
+        };
+        
+        void dispatchMessage( const MessageView & view, int64_t receiveTime );
+        bool hasDispatchBudget();
+        void dispatchCarryOver();
+        void collapseCarryOver();
+        
+        size_t                      dispatchBudgetMessages;
+        int64_t                     dispatchBudgetNanos;
+        size_t                      numDispatched;          // so far in this update()
+        int64_t                     dispatchStart;
+        size_t                      collapseThreshold;
+        size_t                      collapseFloor;          // depth after the last collapse, so a
+                                                            // backlog of many subscriptions isn't rescanned on every push
+        size_t                      maxCarryOverDepth;
+        size_t                      numCollapsed;
+        std::deque<CarriedMessage>  carryOver;
+        std::unordered_set<string>  collapseNames;          // scratch
+        
+        // rate limiting
+        void    flushDelayed();
+        
+        size_t  numRateDropped;
+        size_t  numRateDelayed;
+        size_t  numDelayedQueued;
+        
+        // coalescing
+        size_t  numPending;
+        size_t  numCoalescedSends;
+        int     coalesceInterval;
+        int     lastCoalesceFlush;
     };
     
     /**
@@ -0,0 +1,46 @@
+//
+//  ciSpacebrewApp.h
+//  ciSpacebrew
+//
+//  Optional glue between Spacebrew::Connection and a running Cinder App.
+//
+
+#pragma once
+
+#include "ciSpacebrew.h"
+#include "cinder/app/App.h"
+
+namespace Spacebrew {
+
+    /**
+     * @brief Connection that updates itself from the App's update signal, so you don't have to
+     * call update() yourself. Hooks in on the first connect() (or an explicit setup()).
+     * @class Spacebrew::AppConnection
+     */
+    class AppConnection : public Connection {
+      public:
+
+        /**
+         * @brief Hook update() into ci::app::App::get()->getSignalUpdate(). Safe to call more than once.
+         */
+        void setup(){
+            if ( updateConnection.connected() || ci::app::App::get() == NULL ){
+                return;
+            }
+            updateConnection = ci::app::App::get()->getSignalUpdate().connect( std::bind( &Connection::update, this ) );
+        }
+
+        void connect( string host = SPACEBREW_CLOUD, string name = "cinder app", string description = "" ){
+            setup();
+            Connection::connect( host, name, description );
+        }
+
+        void connect( string host, Config _config ){
+            setup();
+            Connection::connect( host, _config );
+        }
+
+      protected:
+        boost::signals2::scoped_connection updateConnection;
+    };
+}
@@ -0,0 +1,144 @@
+//
+//  ciSpacebrewConnectionPool.cpp
+//  ciSpacebrew
+//
+
+#include "ciSpacebrewConnectionPool.h"
+#include "ciSpacebrew.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace Spacebrew {
+    
+    //--------------------------------------------------------------
+    ConnectionPool::ConnectionPool( size_t numThreads ){
+        if ( numThreads == 0 ){
+            numThreads = std::max( 1u, std::thread::hardware_concurrency() );
+        }
+        
+        bRunning        = true;
+        idleSleepMicros = 500;
+        
+        for ( size_t i = 0; i < numThreads; i++ ){
+            workers.push_back( std::unique_ptr<Worker>( new Worker() ) );
+        }
+        for ( size_t i = 0; i < workers.size(); i++ ){
+            workers[i]->thread = std::thread( &ConnectionPool::workerFunction, this, workers[i].get() );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    ConnectionPool::~ConnectionPool(){
+        bRunning = false;
+        for ( size_t i = 0; i < workers.size(); i++ ){
+            if ( workers[i]->thread.joinable() ){
+                workers[i]->thread.join();
+            }
+        }
+        
+        if ( !connections.empty() ){
+            SPACEBREW_LOG_ERROR( "Spacebrew::ConnectionPool destroyed with " << connections.size() << " Connections still using it" );
+            for ( size_t i = 0; i < connections.size(); i++ ){
+                connections[i]->pool            = NULL;
+                connections[i]->bThreadRunning  = false;
+            }
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void ConnectionPool::update(){
+        for ( size_t i = 0; i < connections.size(); i++ ){
+            connections[i]->update();
+        }
+    }
+    
+    //--------------------------------------------------------------
+    std::vector<size_t> ConnectionPool::getWorkerLoads(){
+        std::vector<size_t> loads;
+        for ( size_t i = 0; i < workers.size(); i++ ){
+            std::lock_guard<std::mutex> lock( workers[i]->mutex );
+            loads.push_back( workers[i]->connections.size() );
+        }
+        return loads;
+    }
+    
+    //--------------------------------------------------------------
+    void ConnectionPool::add( Connection * connection ){
+        if ( std::find( connections.begin(), connections.end(), connection ) == connections.end() ){
+            connections.push_back( connection );
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void ConnectionPool::remove( Connection * connection ){
+        detach( connection );
+        connections.erase( std::remove( connections.begin(), connections.end(), connection ), connections.end() );
+    }
+    
+    //--------------------------------------------------------------
+    void ConnectionPool::attach( Connection * connection ){
+        // least loaded worker; sizes are only changed from this thread, so reading them unlocked is fine
+        Worker * target = workers[0].get();
+        for ( size_t i = 1; i < workers.size(); i++ ){
+            if ( workers[i]->connections.size() < target->connections.size() ){
+                target = workers[i].get();
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock( target->mutex );
+        target->connections.push_back( connection );
+    }
+    
+    //--------------------------------------------------------------
+    void ConnectionPool::detach( Connection * connection ){
+        for ( size_t i = 0; i < workers.size(); i++ ){
+            Worker & w = *workers[i];
+            std::unique_lock<std::mutex> lock( w.mutex );
+            std::vector<Connection *>::iterator it = std::find( w.connections.begin(), w.connections.end(), connection );
+            if ( it != w.connections.end() ){
+                w.connections.erase( it );
+                
+                // Connection::stopThread has cleared bThreadRunning, so a worker blocked on this
+                // Connection's full inbound queue gives up and comes back
+                while ( w.current == connection ){
+                    w.serviced.wait( lock );
+                }
+                return;
+            }
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void ConnectionPool::workerFunction( Worker * worker ){
+        while ( bRunning ){
+            bool bBusy = false;
+            
+            // the lock is only held to pick the next Connection, so one Connection waiting on
+            // a slow app thread never holds up attach / detach of the others
+            for ( size_t i = 0; ; i++ ){
+                Connection * connection;
+                {
+                    std::lock_guard<std::mutex> lock( worker->mutex );
+                    if ( i >= worker->connections.size() ){
+                        break;
+                    }
+                    connection = worker->current = worker->connections[i];
+                }
+                
+                bBusy = connection->serviceIO() || bBusy;
+                
+                {
+                    std::lock_guard<std::mutex> lock( worker->mutex );
+                    worker->current = NULL;
+                }
+                worker->serviced.notify_all();
+            }
+            
+            int sleepMicros = idleSleepMicros;
+            if ( !bBusy && sleepMicros > 0 ){
+                std::this_thread::sleep_for( std::chrono::microseconds( sleepMicros ) );
+            }
+        }
+    }
+}
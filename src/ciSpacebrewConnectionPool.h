@@ -0,0 +1,97 @@
+//
+//  ciSpacebrewConnectionPool.h
+//  ciSpacebrew
+//
+//  Services the sockets of many threaded Connections from a few shared worker threads,
+//  for processes that run hundreds of clients (simulation harnesses, load tests).
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Spacebrew {
+    
+    class Connection;
+    
+    /**
+     * @brief Fixed set of worker threads that take the place of each Connection's own background
+     * thread. Every Connection is pinned to the least loaded worker when it connects; the worker
+     * drains its outgoing queue and polls its WebSocketClient in turn with all the others it owns.
+     * App-side behavior is exactly that of setThreaded(): signals fire from update() on the
+     * calling thread.
+     *
+     * The pool must outlive the Connections that use it.
+     * @example
+     * Spacebrew::ConnectionPool pool( 4 );
+     * for ( size_t i = 0; i < clients.size(); i++ ){
+     *     clients[i]->setThreaded( pool );
+     *     clients[i]->connect( host, "sim-" + toString( i ), "" );
+     * }
+     * // every frame
+     * pool.update();
+     * @class Spacebrew::ConnectionPool
+     */
+    class ConnectionPool {
+      public:
+        
+        /**
+         * @constructor
+         * @param {size_t} numThreads   Worker threads, 0 for one per core
+         */
+        explicit ConnectionPool( size_t numThreads = 0 );
+        ~ConnectionPool();
+        
+        /**
+         * @brief Call update() on every Connection in the pool, from this (the app) thread
+         */
+        void update();
+        
+        /**
+         * @brief How long a worker sleeps after a pass over its Connections found nothing to do
+         * (default 500 micros, 0 to spin)
+         */
+        void setIdleSleep( int micros ){ idleSleepMicros = micros; }
+        
+        size_t getNumThreads() const { return workers.size(); }
+        size_t getNumConnections() const { return connections.size(); }
+        
+        /**
+         * @return Connections currently serviced by each worker
+         */
+        std::vector<size_t> getWorkerLoads();
+        
+      protected:
+        friend class Connection;
+        
+        struct Worker {
+            Worker() : current( NULL ) {}
+            
+            std::thread                 thread;
+            std::mutex                  mutex;
+            std::condition_variable     serviced;   // signalled whenever current goes back to NULL
+            std::vector<Connection *>   connections;
+            Connection *                current;    // being serviced right now, outside the lock
+        };
+        
+        // app thread: Connection::setThreaded( pool ) and ~Connection
+        void add( Connection * connection );
+        void remove( Connection * connection );
+        
+        // start / stop servicing a Connection's socket. detach() returns once no worker is using it
+        void attach( Connection * connection );
+        void detach( Connection * connection );
+        
+        void workerFunction( Worker * worker );
+        
+        std::vector< std::unique_ptr<Worker> >  workers;
+        std::vector<Connection *>               connections;
+        std::atomic<bool>                       bRunning;
+        std::atomic<int>                        idleSleepMicros;
+    };
+}
@@ -0,0 +1,199 @@
+//
+//  ciSpacebrewDispatcher.h
+//  ciSpacebrew
+//
+//  Single-threaded delegate list for the per-message signals, where boost::signals2's locking
+//  and slot tracking cost more than the handlers themselves.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+namespace Spacebrew {
+
+    /**
+     * @brief Handle to a delegate added to a Dispatcher, returned by connect(). Like
+     * boost::signals2::connection it can be copied freely and stays safe to use after the
+     * Dispatcher is gone.
+     * @class Spacebrew::DelegateHandle
+     */
+    class DelegateHandle {
+      public:
+        DelegateHandle() : id( 0 ) {}
+
+        /**
+         * @brief Remove the delegate. During an emission it is skipped from then on and erased
+         * once the emission is over.
+         */
+        void disconnect(){
+            std::shared_ptr<Owner> o = owner.lock();
+            if ( o ) o->remove( id );
+            owner.reset();
+        }
+
+        bool connected() const {
+            std::shared_ptr<Owner> o = owner.lock();
+            return o && o->contains( id );
+        }
+
+      protected:
+        template<typename... Args> friend class Dispatcher;
+
+        struct Owner {
+            virtual ~Owner(){}
+            virtual void remove( uint32_t id ) = 0;
+            virtual bool contains( uint32_t id ) const = 0;
+        };
+
+        DelegateHandle( const std::shared_ptr<Owner> & _owner, uint32_t _id ) : owner( _owner ), id( _id ) {}
+
+        std::weak_ptr<Owner>    owner;
+        uint32_t                id;
+    };
+
+    /**
+     * @brief Flat vector of std::function delegates called in the order they were connected.
+     * Emitting takes no lock, allocates nothing and walks one contiguous array. Delegates may
+     * connect and disconnect (themselves or others) while being called: new delegates are first
+     * called on the next emission, removed ones are skipped right away, and the vector is only
+     * compacted once the outermost emission returns.
+     *
+     * Not thread safe: connect, disconnect and emit from the same thread (for a Connection, the
+     * one calling update()). Pass arguments by const reference, or every delegate gets its own copy.
+     * @example
+     * Spacebrew::Dispatcher<const MessageView &> onView;
+     * Spacebrew::DelegateHandle h = onView.connect( []( const MessageView & m ){ ... } );
+     * onView( view );
+     * h.disconnect();
+     * @class Spacebrew::Dispatcher
+     */
+    template<typename... Args>
+    class Dispatcher {
+      public:
+        typedef std::function<void( Args... )> Delegate;
+
+        Dispatcher() : core( std::make_shared<Core>() ) {}
+
+        /**
+         * @brief Add a delegate
+         * @return Handle you can disconnect() to remove it
+         */
+        DelegateHandle connect( const Delegate & delegate ){
+            Core & c = *core;
+            Entry e;
+            e.id        = c.nextId++;
+            e.delegate  = delegate;
+            if ( c.emitDepth > 0 ){
+                c.added.push_back( e );
+                c.bDirty = true;
+            } else {
+                c.entries.push_back( e );
+            }
+            return DelegateHandle( core, e.id );
+        }
+
+        /**
+         * @brief Remove every delegate
+         */
+        void disconnectAll(){
+            Core & c = *core;
+            c.added.clear();
+            if ( c.emitDepth > 0 ){
+                for ( size_t i = 0; i < c.entries.size(); i++ ) c.entries[i].id = 0;
+                c.bDirty = true;
+            } else {
+                c.entries.clear();
+            }
+        }
+
+        bool    empty() const { return core->entries.empty() && core->added.empty(); }
+        size_t  size() const { return core->entries.size() + core->added.size(); }
+
+        /**
+         * @brief Call every delegate
+         */
+        void operator()( Args... args ){
+            Core & c = *core;
+            if ( c.entries.empty() ) return;
+
+            EmitScope scope( c );
+            // entries doesn't grow or shrink while emitting, see connect / Core::remove
+            const size_t n = c.entries.size();
+            for ( size_t i = 0; i < n; i++ ){
+                if ( c.entries[i].id ){
+                    c.entries[i].delegate( args... );
+                }
+            }
+        }
+
+      protected:
+        struct Entry {
+            uint32_t    id;     // 0 once removed during an emission
+            Delegate    delegate;
+        };
+
+        struct Core : DelegateHandle::Owner {
+            Core() : nextId( 1 ), emitDepth( 0 ), bDirty( false ) {}
+
+            void remove( uint32_t id ){
+                for ( size_t i = 0; i < entries.size(); i++ ){
+                    if ( entries[i].id != id ) continue;
+                    if ( emitDepth > 0 ){
+                        entries[i].id = 0;
+                        bDirty = true;
+                    } else {
+                        entries.erase( entries.begin() + i );
+                    }
+                    return;
+                }
+                for ( size_t i = 0; i < added.size(); i++ ){
+                    if ( added[i].id == id ){
+                        added.erase( added.begin() + i );
+                        return;
+                    }
+                }
+            }
+
+            bool contains( uint32_t id ) const {
+                for ( size_t i = 0; i < entries.size(); i++ ) if ( entries[i].id == id ) return true;
+                for ( size_t i = 0; i < added.size(); i++ ) if ( added[i].id == id ) return true;
+                return false;
+            }
+
+            // apply the connects / disconnects made during the emission that just ended
+            void compact(){
+                entries.erase( std::remove_if( entries.begin(), entries.end(), isRemoved ), entries.end() );
+                entries.insert( entries.end(), added.begin(), added.end() );
+                added.clear();
+                bDirty = false;
+            }
+
+            static bool isRemoved( const Entry & e ){ return e.id == 0; }
+
+            std::vector<Entry>  entries;
+            std::vector<Entry>  added;
+            uint32_t            nextId;
+            int                 emitDepth;
+            bool                bDirty;
+        };
+
+        // unwinds emitDepth even if a delegate throws
+        struct EmitScope {
+            explicit EmitScope( Core & _c ) : c( _c ) { c.emitDepth++; }
+            ~EmitScope(){
+                if ( --c.emitDepth == 0 && c.bDirty ) c.compact();
+            }
+            Core & c;
+        };
+
+        Dispatcher( const Dispatcher & );
+        Dispatcher & operator=( const Dispatcher & );
+
+        std::shared_ptr<Core> core;
+    };
+}
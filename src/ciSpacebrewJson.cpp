@@ -0,0 +1,694 @@
+//
+//  ciSpacebrewJson.cpp
+//  ciSpacebrew
+//
+
+#include "ciSpacebrewJson.h"
+
+#include <cmath>
+#include <cstdio>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define SPACEBREW_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <limits>
+#include <locale>
+#include <sstream>
+
+namespace Spacebrew {
+    
+    namespace {
+        
+        inline const char * skipSpace( const char * p, const char * end ){
+            while ( p < end && ( *p == ' ' || *p == '\n' || *p == '\r' || *p == '\t' ) ) p++;
+            return p;
+        }
+        
+        inline unsigned firstBit( unsigned mask ){
+#ifdef _MSC_VER
+            unsigned long i;
+            _BitScanForward( &i, mask );
+            return (unsigned) i;
+#else
+            return (unsigned) __builtin_ctz( mask );
+#endif
+        }
+        
+        inline bool isSpecial( unsigned char c, bool bControl ){
+            return c == '"' || c == '\\' || ( bControl && c < 0x20 );
+        }
+        
+        // length of the leading run of p that can go between quotes as is: stops at '"', '\' and,
+        // with bControl, at control characters. 16 bytes per step with SSE2, 8 otherwise.
+        inline size_t scanString( const char * p, size_t len, bool bControl ){
+            size_t i = 0;
+#ifdef SPACEBREW_SSE2
+            const __m128i quote     = _mm_set1_epi8( '"' );
+            const __m128i backslash = _mm_set1_epi8( '\\' );
+            const __m128i control   = _mm_set1_epi8( 0x1F );
+            for ( ; i + 16 <= len; i += 16 ){
+                __m128i x = _mm_loadu_si128( (const __m128i *)( p + i ) );
+                __m128i m = _mm_or_si128( _mm_cmpeq_epi8( x, quote ), _mm_cmpeq_epi8( x, backslash ) );
+                if ( bControl ){
+                    // x <= 0x1F (unsigned)
+                    m = _mm_or_si128( m, _mm_cmpeq_epi8( _mm_min_epu8( x, control ), x ) );
+                }
+                unsigned mask = (unsigned) _mm_movemask_epi8( m );
+                if ( mask ){
+                    return i + firstBit( mask );
+                }
+            }
+#else
+            // has-zero-byte tricks; a hit only means "look closer", the scalar loop below finds it
+            const uint64_t kOnes    = 0x0101010101010101ULL;
+            const uint64_t kHigh    = 0x8080808080808080ULL;
+            for ( ; i + 8 <= len; i += 8 ){
+                uint64_t v;
+                memcpy( &v, p + i, 8 );
+                uint64_t q  = v ^ ( kOnes * '"' );
+                uint64_t b  = v ^ ( kOnes * '\\' );
+                uint64_t m  = ( ( q - kOnes ) & ~q ) | ( ( b - kOnes ) & ~b );
+                if ( bControl ){
+                    m |= ( v - kOnes * 0x20 ) & ~v;
+                }
+                if ( m & kHigh ) break;
+            }
+#endif
+            for ( ; i < len; i++ ){
+                if ( isSpecial( (unsigned char) p[i], bControl ) ) break;
+            }
+            return i;
+        }
+        
+        inline int hexValue( char c ){
+            if ( c >= '0' && c <= '9' ) return c - '0';
+            if ( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+            if ( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+            return -1;
+        }
+        
+        inline int readHex4( const char * p ){
+            int a = hexValue( p[0] ), b = hexValue( p[1] ), c = hexValue( p[2] ), d = hexValue( p[3] );
+            return ( a | b | c | d ) < 0 ? -1 : ( a << 12 ) | ( b << 8 ) | ( c << 4 ) | d;
+        }
+        
+        // p points at the opening quote. On success out holds the raw (still escaped) contents and
+        // the returned pointer is just past the closing quote; NULL means a bad escape or an
+        // unterminated string. bEscaped says whether out needs unescapeInPlace.
+        inline const char * readString( const char * p, const char * end, StringRef & out, bool & bEscaped ){
+            const char * start = ++p;
+            bEscaped = false;
+            for (;;){
+                p += scanString( p, end - p, false );
+                if ( p == end ) return NULL;
+                if ( *p == '"' ) break;
+                
+                // backslash: only check the escape is well formed here
+                bEscaped = true;
+                if ( end - p < 2 ) return NULL;
+                switch ( p[1] ){
+                    case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                        p += 2;
+                        break;
+                    case 'u':
+                        if ( end - p < 6 || readHex4( p + 2 ) < 0 ) return NULL;
+                        p += 6;
+                        break;
+                    default:
+                        return NULL;
+                }
+            }
+            out = StringRef( start, p - start );
+            return p + 1;
+        }
+        
+        inline char * writeUtf8( unsigned cp, char * w ){
+            if ( cp < 0x80 ){
+                *w++ = (char) cp;
+            } else if ( cp < 0x800 ){
+                *w++ = (char)( 0xC0 | ( cp >> 6 ) );
+                *w++ = (char)( 0x80 | ( cp & 0x3F ) );
+            } else if ( cp < 0x10000 ){
+                *w++ = (char)( 0xE0 | ( cp >> 12 ) );
+                *w++ = (char)( 0x80 | ( ( cp >> 6 ) & 0x3F ) );
+                *w++ = (char)( 0x80 | ( cp & 0x3F ) );
+            } else {
+                *w++ = (char)( 0xF0 | ( cp >> 18 ) );
+                *w++ = (char)( 0x80 | ( ( cp >> 12 ) & 0x3F ) );
+                *w++ = (char)( 0x80 | ( ( cp >> 6 ) & 0x3F ) );
+                *w++ = (char)( 0x80 | ( cp & 0x3F ) );
+            }
+            return w;
+        }
+        
+        // s was checked by readString. Unescaped text is never longer than its escaped form, so
+        // this writes over s itself; clean runs are moved in bulk. Returns the new length.
+        size_t unescapeInPlace( char * s, size_t len ){
+            char *          w   = s;
+            const char *    p   = s;
+            const char *    end = s + len;
+            
+            while ( p < end ){
+                size_t run = scanString( p, end - p, false );
+                if ( w != p ) memmove( w, p, run );
+                w += run;
+                p += run;
+                if ( p == end ) break;
+                
+                char e = p[1];
+                p += 2;
+                switch ( e ){
+                    case 'b': *w++ = '\b'; break;
+                    case 'f': *w++ = '\f'; break;
+                    case 'n': *w++ = '\n'; break;
+                    case 'r': *w++ = '\r'; break;
+                    case 't': *w++ = '\t'; break;
+                    case 'u': {
+                        unsigned cp = (unsigned) readHex4( p );
+                        p += 4;
+                        if ( cp >= 0xD800 && cp <= 0xDBFF ){
+                            // surrogate pair, or U+FFFD for a lone high surrogate
+                            int low = ( end - p >= 6 && p[0] == '\\' && p[1] == 'u' ) ? readHex4( p + 2 ) : -1;
+                            if ( low >= 0xDC00 && low <= 0xDFFF ){
+                                cp = 0x10000 + ( ( cp - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+                                p += 6;
+                            } else {
+                                cp = 0xFFFD;
+                            }
+                        } else if ( cp >= 0xDC00 && cp <= 0xDFFF ){
+                            cp = 0xFFFD;
+                        }
+                        w = writeUtf8( cp, w );
+                        break;
+                    }
+                    default: *w++ = e; break;
+                }
+            }
+            return w - s;
+        }
+        
+        inline bool isDigit( char c ){
+            return c >= '0' && c <= '9';
+        }
+        
+        // end of the JSON number at p (-?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?), NULL if there isn't one
+        inline const char * skipNumber( const char * p, const char * end ){
+            if ( p < end && *p == '-' ) p++;
+            if ( p == end || !isDigit( *p ) ) return NULL;
+            if ( *p == '0' ){
+                p++;
+            } else {
+                while ( p < end && isDigit( *p ) ) p++;
+            }
+            if ( p < end && *p == '.' ){
+                if ( ++p == end || !isDigit( *p ) ) return NULL;
+                while ( p < end && isDigit( *p ) ) p++;
+            }
+            if ( p < end && ( *p == 'e' || *p == 'E' ) ){
+                if ( ++p < end && ( *p == '+' || *p == '-' ) ) p++;
+                if ( p == end || !isDigit( *p ) ) return NULL;
+                while ( p < end && isDigit( *p ) ) p++;
+            }
+            return p;
+        }
+        
+        // number, true, false or null
+        inline const char * skipLiteral( const char * p, const char * end ){
+            size_t left = end - p;
+            switch ( *p ){
+                case 't': return left >= 4 && memcmp( p, "true", 4 ) == 0 ? p + 4 : NULL;
+                case 'f': return left >= 5 && memcmp( p, "false", 5 ) == 0 ? p + 5 : NULL;
+                case 'n': return left >= 4 && memcmp( p, "null", 4 ) == 0 ? p + 4 : NULL;
+                default:  return skipNumber( p, end );
+            }
+        }
+        
+        // p points at '['. Arrays of literals and arrays, anything with strings or objects is left to JsonTree
+        const char * skipArray( const char * p, const char * end, int depth ){
+            if ( depth > 32 ) return NULL;
+            p = skipSpace( p + 1, end );
+            if ( p < end && *p == ']' ) return p + 1;
+            for (;;){
+                if ( p == end ) return NULL;
+                p = *p == '[' ? skipArray( p, end, depth + 1 ) : skipLiteral( p, end );
+                if ( p == NULL ) return NULL;
+                p = skipSpace( p, end );
+                if ( p == end ) return NULL;
+                if ( *p == ']' ) return p + 1;
+                if ( *p != ',' ) return NULL;
+                p = skipSpace( p + 1, end );
+            }
+        }
+        
+        // unquoted value: a literal or an array of them
+        inline const char * readRawValue( const char * p, const char * end, StringRef & out ){
+            const char * start = p;
+            p = *p == '[' ? skipArray( p, end, 0 ) : skipLiteral( p, end );
+            if ( p == NULL ) return NULL;
+            out = StringRef( start, p - start );
+            return p;
+        }
+        
+        inline bool keyIs( const StringRef & key, const char * lit, size_t litLen ){
+            return key.size == litLen && memcmp( key.data, lit, litLen ) == 0;
+        }
+        
+        inline void unescapeField( char * data, StringRef & field, bool bEscaped ){
+            if ( bEscaped ){
+                char * s = data + ( field.data - data );
+                field.size = unescapeInPlace( s, field.size );
+            }
+        }
+    }
+    
+    //--------------------------------------------------------------
+    bool parseMessageFrame( char * data, size_t len, MessageFrame & frame ){
+        const char * p      = data;
+        const char * end    = data + len;
+        StringRef key;
+        bool bEscaped;
+        
+        frame = MessageFrame();
+        frame.bValueQuoted = false;
+        
+        // {"message":
+        p = skipSpace( p, end );
+        if ( p == end || *p != '{' ) return false;
+        p = skipSpace( p + 1, end );
+        if ( p == end || *p != '"' || ( p = readString( p, end, key, bEscaped ) ) == NULL ) return false;
+        if ( bEscaped || !keyIs( key, "message", 7 ) ) return false;
+        p = skipSpace( p, end );
+        if ( p == end || *p != ':' ) return false;
+        p = skipSpace( p + 1, end );
+        if ( p == end || *p != '{' ) return false;
+        p++;
+        
+        bool bHaveValue     = false;
+        bool bNameEscaped   = false;
+        bool bTypeEscaped   = false;
+        bool bValueEscaped  = false;
+        bool bClientEscaped = false;
+        
+        for (;;){
+            p = skipSpace( p, end );
+            if ( p == end || *p != '"' || ( p = readString( p, end, key, bEscaped ) ) == NULL ) return false;
+            if ( bEscaped ) return false;
+            p = skipSpace( p, end );
+            if ( p == end || *p != ':' ) return false;
+            p = skipSpace( p + 1, end );
+            if ( p == end ) return false;
+            
+            StringRef val;
+            bool bQuoted = ( *p == '"' );
+            bEscaped = false;
+            if ( bQuoted ){
+                p = readString( p, end, val, bEscaped );
+            } else {
+                p = readRawValue( p, end, val );
+            }
+            if ( p == NULL ) return false;
+            
+            if ( keyIs( key, "name", 4 ) ){
+                frame.name      = val;
+                bNameEscaped    = bEscaped;
+            } else if ( keyIs( key, "type", 4 ) ){
+                frame.type      = val;
+                bTypeEscaped    = bEscaped;
+            } else if ( keyIs( key, "value", 5 ) ){
+                frame.value         = val;
+                frame.bValueQuoted  = bQuoted;
+                bValueEscaped       = bEscaped;
+                bHaveValue          = true;
+            } else if ( keyIs( key, "clientName", 10 ) ){
+                frame.clientName    = val;
+                bClientEscaped      = bEscaped;
+            }
+            
+            // exactly one comma between members
+            p = skipSpace( p, end );
+            if ( p == end ) return false;
+            if ( *p == '}' ){
+                p++;
+                break;
+            }
+            if ( *p != ',' ) return false;
+            p++;
+        }
+        
+        // closing brace of the envelope, then nothing but whitespace
+        p = skipSpace( p, end );
+        if ( p == end || *p != '}' ) return false;
+        p = skipSpace( p + 1, end );
+        
+        if ( p != end || !bHaveValue || frame.name.empty() ){
+            return false;
+        }
+        
+        // only touch the buffer once the whole frame is known good, so callers can still
+        // hand it to JsonTree after a false return
+        unescapeField( data, frame.name, bNameEscaped );
+        unescapeField( data, frame.type, bTypeEscaped );
+        unescapeField( data, frame.value, bValueEscaped );
+        unescapeField( data, frame.clientName, bClientEscaped );
+        return true;
+    }
+    
+    //--------------------------------------------------------------
+    void JsonWriter::escaped( const char * s, size_t len ){
+        static const char kHex[] = "0123456789abcdef";
+        
+        for (;;){
+            size_t run = scanString( s, len, true );
+            out->append( s, run );
+            if ( run == len ){
+                return;
+            }
+            
+            unsigned char c = (unsigned char) s[ run ];
+            switch ( c ){
+                case '"':   out->append( "\\\"", 2 ); break;
+                case '\\':  out->append( "\\\\", 2 ); break;
+                case '\b':  out->append( "\\b", 2 ); break;
+                case '\f':  out->append( "\\f", 2 ); break;
+                case '\n':  out->append( "\\n", 2 ); break;
+                case '\r':  out->append( "\\r", 2 ); break;
+                case '\t':  out->append( "\\t", 2 ); break;
+                default: {
+                    char u[ 6 ] = { '\\', 'u', '0', '0', kHex[ c >> 4 ], kHex[ c & 15 ] };
+                    out->append( u, 6 );
+                    break;
+                }
+            }
+            s   += run + 1;
+            len -= run + 1;
+        }
+    }
+    
+    namespace {
+        
+        // exact powers of ten representable as doubles
+        const double kPow10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        
+#if defined( _WIN32 ) || ( defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ )
+#define SPACEBREW_SWAR_DIGITS 1
+        
+        // eight ASCII digits at once, eight bytes loaded into one little-endian word
+        inline bool isEightDigits( uint64_t v ){
+            return ( ( v & 0xF0F0F0F0F0F0F0F0ULL ) | ( ( ( v + 0x0606060606060606ULL ) & 0xF0F0F0F0F0F0F0F0ULL ) >> 4 ) ) == 0x3333333333333333ULL;
+        }
+        
+        inline uint32_t parseEightDigits( uint64_t v ){
+            v -= 0x3030303030303030ULL;
+            v = ( v * 10 ) + ( v >> 8 );
+            v = ( ( ( v & 0x000000FF000000FFULL ) * ( 100 + ( 1000000ULL << 32 ) ) ) +
+                  ( ( ( v >> 16 ) & 0x000000FF000000FFULL ) * ( 1 + ( 10000ULL << 32 ) ) ) ) >> 32;
+            return (uint32_t) v;
+        }
+#endif
+        
+        // appends digits to mantissa while it stays below 10^17; numDigits counts every digit read,
+        // numDropped the ones that didn't fit
+        inline const char * readDigits( const char * p, const char * end, uint64_t & mantissa, int & numDigits, int & numDropped ){
+            const char * start = p;
+#ifdef SPACEBREW_SWAR_DIGITS
+            while ( end - p >= 8 && mantissa < 1000000000ULL ){
+                uint64_t chunk;
+                memcpy( &chunk, p, 8 );
+                if ( !isEightDigits( chunk ) ) break;
+                mantissa = mantissa * 100000000ULL + parseEightDigits( chunk );
+                p += 8;
+            }
+#endif
+            for ( ; p < end && *p >= '0' && *p <= '9'; p++ ){
+                if ( mantissa < 100000000000000000ULL ){
+                    mantissa = mantissa * 10 + ( *p - '0' );
+                } else {
+                    numDropped++;
+                }
+            }
+            numDigits += (int)( p - start );
+            return p;
+        }
+        
+        // JSON number starting at p. Returns the end of the number, or NULL if there isn't one
+        const char * readNumber( const char * p, const char * end, double & out ){
+            const char * start  = p;
+            bool bNegative      = false;
+            if ( p < end && *p == '-' ){
+                bNegative = true;
+                p++;
+            }
+            
+            uint64_t    mantissa    = 0;
+            int         numDigits   = 0;
+            int         numDropped  = 0;
+            int         exponent    = 0;
+            
+            // integer part, no leading zeros: digits that don't fit scale the result up
+            if ( p == end || !isDigit( *p ) ) return NULL;
+            if ( *p == '0' ){
+                p++;
+                numDigits = 1;
+            } else {
+                p = readDigits( p, end, mantissa, numDigits, numDropped );
+                exponent += numDropped;
+            }
+            
+            if ( p < end && *p == '.' ){
+                // fraction, at least one digit: digits that don't fit are simply truncated
+                if ( p + 1 == end || !isDigit( p[1] ) ) return NULL;
+                int numFraction = 0;
+                numDropped = 0;
+                p = readDigits( p + 1, end, mantissa, numFraction, numDropped );
+                exponent -= numFraction - numDropped;
+                numDigits += numFraction;
+            }
+            
+            if ( p < end && ( *p == 'e' || *p == 'E' ) ){
+                p++;
+                bool bNegExp = false;
+                if ( p < end && ( *p == '+' || *p == '-' ) ){
+                    bNegExp = ( *p == '-' );
+                    p++;
+                }
+                if ( p == end || *p < '0' || *p > '9' ) return NULL;
+                int e = 0;
+                for ( ; p < end && *p >= '0' && *p <= '9'; p++ ){
+                    if ( e < 100000 ) e = e * 10 + ( *p - '0' );
+                }
+                exponent += bNegExp ? -e : e;
+            }
+            
+            // exact whenever the mantissa and the power of ten are both exact doubles (Clinger's fast path)
+            if ( mantissa <= ( uint64_t( 1 ) << 53 ) && exponent >= -22 && exponent <= 22 ){
+                double d = (double) mantissa;
+                d = exponent < 0 ? d / kPow10[ -exponent ] : d * kPow10[ exponent ];
+                out = bNegative ? -d : d;
+                return p;
+            }
+            
+            // rare: long mantissas or large exponents. Classic locale keeps "." as the decimal point
+            std::istringstream ss( std::string( start, p - start ) );
+            ss.imbue( std::locale::classic() );
+            double d = 0;
+            ss >> d;
+            if ( ss.fail() ) return NULL;
+            out = d;
+            return p;
+        }
+        
+        // is d, the double nearest to some decimal, far enough from a float rounding boundary that
+        // the decimal itself rounds to v as well? (always, if d is the decimal exactly)
+        inline bool roundTrips( double d, bool bExact, float v ){
+            if ( (float) d != v ) return false;
+            if ( bExact ) return true;
+            float   next    = d > v ? std::nextafter( v, std::numeric_limits<float>::infinity() ) : std::nextafter( v, -std::numeric_limits<float>::infinity() );
+            double  mid     = ( (double) v + (double) next ) * 0.5;
+            return std::fabs( d - mid ) > std::fabs( d ) * 4.5e-16;
+        }
+        
+        // a (a float, 10^e10 <= a < 10^(e10 + 1)) rounded to numDigits significant digits:
+        // digits * 10^( exp10 - numDigits + 1 ). False if that doesn't read back as a
+        inline bool roundTripDigits( double a, int e10, int numDigits, uint32_t & digits, int & exp10 ){
+            static const uint32_t kIntPow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+            
+            int     shift   = numDigits - 1 - e10;
+            double  scaled  = shift >= 0 ? a * kPow10[ shift ] : a / kPow10[ -shift ];
+            digits  = (uint32_t)( scaled + 0.5 );
+            exp10   = e10;
+            if ( digits >= kIntPow10[ numDigits ] ){
+                // rounded up a decade (9.99 -> 10)
+                digits /= 10;
+                exp10++;
+                shift--;
+            }
+            if ( digits < kIntPow10[ numDigits - 1 ] ) return false;
+            
+            double back = shift >= 0 ? digits / kPow10[ shift ] : digits * kPow10[ -shift ];
+            return roundTrips( back, shift <= 0 && back <= 9007199254740992.0, (float) a );
+        }
+        
+        // digits (numDigits long, no trailing zeros) * 10^( decimalExponent - numDigits + 1 )
+        size_t writeDecimal( bool bNegative, uint32_t digits, int numDigits, int decimalExponent, char * buf ){
+            char    d[ 12 ];
+            for ( int i = numDigits - 1; i >= 0; i-- ){
+                d[ i ] = (char)( '0' + digits % 10 );
+                digits /= 10;
+            }
+            
+            char * p = buf;
+            if ( bNegative ) *p++ = '-';
+            
+            if ( decimalExponent >= 0 && decimalExponent <= 20 ){
+                // 123, 1.25, 1200
+                int intDigits = decimalExponent + 1;
+                for ( int i = 0; i < intDigits; i++ ){
+                    *p++ = i < numDigits ? d[ i ] : '0';
+                }
+                if ( numDigits > intDigits ){
+                    *p++ = '.';
+                    for ( int i = intDigits; i < numDigits; i++ ) *p++ = d[ i ];
+                }
+            } else if ( decimalExponent < 0 && decimalExponent >= -6 ){
+                // 0.00125
+                *p++ = '0';
+                *p++ = '.';
+                for ( int i = -1; i > decimalExponent; i-- ) *p++ = '0';
+                for ( int i = 0; i < numDigits; i++ ) *p++ = d[ i ];
+            } else {
+                // 1.25e-7
+                *p++ = d[ 0 ];
+                if ( numDigits > 1 ){
+                    *p++ = '.';
+                    for ( int i = 1; i < numDigits; i++ ) *p++ = d[ i ];
+                }
+                *p++ = 'e';
+                p += JsonWriter::formatInt( decimalExponent, p );
+            }
+            return p - buf;
+        }
+    }
+    
+    //--------------------------------------------------------------
+    bool parseNumber( const StringRef & s, double & out ){
+        const char * p      = skipSpace( s.data, s.data + s.size );
+        const char * end    = s.data + s.size;
+        while ( end > p && ( end[-1] == ' ' || end[-1] == '\n' || end[-1] == '\r' || end[-1] == '\t' ) ) end--;
+        if ( p == end ) return false;
+        
+        double d;
+        if ( readNumber( p, end, d ) != end ) return false;
+        out = d;
+        return true;
+    }
+    
+    //--------------------------------------------------------------
+    bool parseFloatArray( const StringRef & s, std::vector<float> & out ){
+        const char * p      = skipSpace( s.data, s.data + s.size );
+        const char * end    = s.data + s.size;
+        
+        out.clear();
+        if ( p == end || *p != '[' ) return false;
+        p = skipSpace( p + 1, end );
+        if ( p < end && *p == ']' ){
+            return skipSpace( p + 1, end ) == end;
+        }
+        
+        for (;;){
+            double d;
+            if ( end - p >= 4 && memcmp( p, "null", 4 ) == 0 ){
+                d = std::numeric_limits<double>::quiet_NaN();
+                p += 4;
+            } else if ( ( p = readNumber( p, end, d ) ) == NULL ){
+                out.clear();
+                return false;
+            }
+            out.push_back( (float) d );
+            
+            p = skipSpace( p, end );
+            if ( p == end ) break;
+            if ( *p == ']' ){
+                if ( skipSpace( p + 1, end ) == end ) return true;
+                break;
+            }
+            if ( *p != ',' ) break;
+            p = skipSpace( p + 1, end );
+        }
+        out.clear();
+        return false;
+    }
+    
+    //--------------------------------------------------------------
+    size_t JsonWriter::formatFloat( float v, char * buf ){
+        if ( v != v || std::fabs( v ) == std::numeric_limits<float>::infinity() ){
+            memcpy( buf, "null", 4 );
+            return 4;
+        }
+        bool    bNegative   = std::signbit( v );
+        double  a           = std::fabs( (double) v );
+        if ( a == 0 ){
+            if ( bNegative ) *buf++ = '-';
+            *buf = '0';
+            return bNegative ? 2 : 1;
+        }
+        
+        // 10^e10 <= a < 10^(e10 + 1). The binary exponent gets within one step (78913 / 2^18 ~ log10(2))
+        int exp2;
+        std::frexp( a, &exp2 );
+        int e10 = ( ( exp2 - 1 ) * 78913 ) >> 18;
+        if ( e10 >= -13 && e10 <= 21 && a >= ( e10 + 1 >= 0 ? kPow10[ e10 + 1 ] : 1 / kPow10[ -e10 - 1 ] ) ){
+            e10++;
+        }
+        
+        if ( e10 >= -13 && e10 <= 21 ){
+            // round trips only get more likely with more digits, so binary search for the fewest
+            uint32_t    digits;
+            int         exp10;
+            int         lo  = 1;
+            int         hi  = 9;
+            if ( roundTripDigits( a, e10, hi, digits, exp10 ) ){
+                while ( lo < hi ){
+                    int         mid = ( lo + hi ) / 2;
+                    uint32_t    midDigits;
+                    int         midExp10;
+                    if ( roundTripDigits( a, e10, mid, midDigits, midExp10 ) ){
+                        hi      = mid;
+                        digits  = midDigits;
+                        exp10   = midExp10;
+                    } else {
+                        lo = mid + 1;
+                    }
+                }
+                
+                int n = hi;
+                while ( n > 1 && digits % 10 == 0 ){
+                    digits /= 10;
+                    n--;
+                }
+                return writeDecimal( bNegative, digits, n, exp10, buf );
+            }
+        }
+        
+        // denormals and the far ends of the range: let the C library find the shortest
+        for ( int precision = 1; precision <= 9; precision++ ){
+            char tmp[ 32 ];
+            int len = snprintf( tmp, sizeof(tmp), "%.*g", precision, (double) v );
+            for ( int i = 0; i < len; i++ ){
+                if ( tmp[ i ] == ',' ) tmp[ i ] = '.';
+            }
+            double back;
+            if ( precision == 9 || ( readNumber( tmp, tmp + len, back ) == tmp + len && (float) back == v ) ){
+                memcpy( buf, tmp, len );
+                return len;
+            }
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,214 @@
+//
+//  ciSpacebrewJson.h
+//  ciSpacebrew
+//
+//  Small, allocation-free helpers for writing and parsing Spacebrew frames.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+
+namespace Spacebrew {
+
+    /**
+     * @brief Non-owning view of a run of characters, usually inside a received frame.
+     * Only valid for as long as the buffer it points into.
+     * @class Spacebrew::StringRef
+     */
+    struct StringRef {
+        StringRef() : data( NULL ), size( 0 ) {}
+        StringRef( const char * _data, size_t _size ) : data( _data ), size( _size ) {}
+        StringRef( const std::string & s ) : data( s.data() ), size( s.size() ) {}
+
+        inline bool         empty() const { return size == 0; }
+        inline std::string  str() const { return std::string( data, size ); }
+
+        inline bool operator==( const StringRef & o ) const {
+            return size == o.size && ( size == 0 || memcmp( data, o.data, size ) == 0 );
+        }
+        inline bool operator!=( const StringRef & o ) const { return !( *this == o ); }
+
+        const char *    data;
+        size_t          size;
+    };
+
+    /**
+     * @brief Fields of a {"message":{...}} frame, as views into the frame buffer
+     */
+    struct MessageFrame {
+        StringRef   clientName;
+        StringRef   name;
+        StringRef   type;
+
+        /**
+         * @brief String contents for quoted values, raw JSON text otherwise (numbers, true/false, arrays)
+         */
+        StringRef   value;
+        bool        bValueQuoted;
+    };
+
+    /**
+     * @brief Single pass parser for the fixed Spacebrew message envelope. Works in place on
+     * the received buffer and never allocates: escaped strings are unescaped over themselves.
+     * @return false if the frame isn't a plain message frame (config/admin frames, values that are
+     * nested objects, malformed JSON). The buffer is left untouched then, so callers can fall back
+     * to JsonTree on it.
+     */
+    bool parseMessageFrame( char * data, size_t len, MessageFrame & frame );
+
+    /**
+     * @brief Locale-independent number parser (JSON number syntax, leading/trailing spaces allowed)
+     * @return false unless the whole of s is a number
+     */
+    bool parseNumber( const StringRef & s, double & out );
+
+    /**
+     * @brief Parse a JSON array of numbers ("[0.5,1,-2e3]") into out. null elements become NaN.
+     * Digits are consumed eight at a time where the platform allows.
+     * @return false (and out empty) if s isn't a flat array of numbers
+     */
+    bool parseFloatArray( const StringRef & s, std::vector<float> & out );
+
+    /**
+     * @brief Streaming JSON writer that appends straight into a caller-owned std::string.
+     * The buffer is cleared (not freed) on reset, so once it has grown to the size of your
+     * largest frame no further heap allocation happens.
+     * @class Spacebrew::JsonWriter
+     */
+    class JsonWriter {
+      public:
+
+        /** @constructor */
+        explicit JsonWriter( std::string & buffer ) : out( &buffer ) {}
+
+        /**
+         * @brief Empty the buffer, keeping its capacity
+         */
+        inline void reset(){ out->clear(); }
+
+        inline void raw( const char * s, size_t len ){ out->append( s, len ); }
+        inline void raw( const std::string & s ){ out->append( s ); }
+        inline void raw( char c ){ out->push_back( c ); }
+
+        /**
+         * @brief Append a quoted, escaped string
+         */
+        inline void quoted( const char * s, size_t len ){
+            out->push_back( '"' );
+            escaped( s, len );
+            out->push_back( '"' );
+        }
+        inline void quoted( const std::string & s ){ quoted( s.data(), s.size() ); }
+
+        /**
+         * @brief Append s escaped for use inside a JSON string (quotes, backslashes, control
+         * characters; UTF-8 passes through). Clean runs are found 16 bytes at a time and copied in bulk.
+         */
+        void escaped( const char * s, size_t len );
+
+        /**
+         * @brief Append an integer without going through stringstream
+         */
+        inline void integer( int64_t v ){
+            char buf[ 24 ];
+            size_t len = formatInt( v, buf );
+            out->append( buf, len );
+        }
+
+        /**
+         * @brief Append a JSON array of floats, each in its shortest round-trip form
+         */
+        inline void floatArray( const float * values, size_t count ){
+            char buf[ 32 ];
+            out->push_back( '[' );
+            for ( size_t i = 0; i < count; i++ ){
+                if ( i > 0 ) out->push_back( ',' );
+                out->append( buf, formatFloat( values[i], buf ) );
+            }
+            out->push_back( ']' );
+        }
+
+        /**
+         * @brief Write a full {"message":{...}} frame. "string" and "boolean" values are quoted,
+         * everything else (range, custom types) is written raw, same as Message::getJSON.
+         */
+        inline void message( const std::string & clientName, const std::string & name, const std::string & type, const char * value, size_t valueLen ){
+            static const char   kClient[]   = "{\"message\":{\"clientName\":";
+            static const char   kName[]     = ",\"name\":";
+            static const char   kType[]     = ",\"type\":";
+            static const char   kValue[]    = ",\"value\":";
+            static const char   kClose[]    = "}}";
+
+            raw( kClient, sizeof(kClient) - 1 );
+            quoted( clientName );
+            raw( kName, sizeof(kName) - 1 );
+            quoted( name );
+            raw( kType, sizeof(kType) - 1 );
+            quoted( type );
+            raw( kValue, sizeof(kValue) - 1 );
+            if ( isQuotedType( type ) ){
+                quoted( value, valueLen );
+            } else {
+                raw( value, valueLen );
+            }
+            raw( kClose, sizeof(kClose) - 1 );
+        }
+
+        inline void message( const std::string & clientName, const std::string & name, const std::string & type, const std::string & value ){
+            message( clientName, name, type, value.data(), value.size() );
+        }
+
+        /**
+         * @return Is this type's value sent as a JSON string (as opposed to a raw number / custom JSON)?
+         */
+        static inline bool isQuotedType( const std::string & type ){
+            return type == "string" || type == "boolean";
+        }
+
+        /**
+         * @brief Format an integer into buf (needs 21 bytes), returns length written
+         */
+        static inline size_t formatInt( int64_t v, char * buf ){
+            static const char kDigits[] =
+                "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+
+            char        tmp[ 24 ];
+            char *      p   = tmp + sizeof(tmp);
+            uint64_t    u   = v < 0 ? 0 - (uint64_t) v : (uint64_t) v;
+
+            while ( u >= 100 ){
+                unsigned i = (unsigned)( u % 100 ) * 2;
+                u /= 100;
+                *--p = kDigits[ i + 1 ];
+                *--p = kDigits[ i ];
+            }
+            if ( u >= 10 ){
+                unsigned i = (unsigned) u * 2;
+                *--p = kDigits[ i + 1 ];
+                *--p = kDigits[ i ];
+            } else {
+                *--p = (char)( '0' + u );
+            }
+            if ( v < 0 ) *--p = '-';
+
+            size_t len = tmp + sizeof(tmp) - p;
+            memcpy( buf, p, len );
+            return len;
+        }
+
+        /**
+         * @brief Format a float into buf (needs 32 bytes) using the fewest digits that read back
+         * as exactly the same float. NaN and infinities are written as null. Returns length written
+         */
+        static size_t formatFloat( float v, char * buf );
+
+      protected:
+        std::string * out;
+    };
+}
@@ -0,0 +1,95 @@
+//
+//  ciSpacebrewLog.cpp
+//  ciSpacebrew
+//
+
+#include "ciSpacebrewLog.h"
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+
+namespace Spacebrew {
+
+    namespace {
+
+        std::mutex & handlerMutex(){
+            static std::mutex m;
+            return m;
+        }
+
+        LogHandler & handler(){
+            static LogHandler h;
+            return h;
+        }
+
+        const char * levelName( LogLevel level ){
+            switch ( level ){
+                case LOG_LEVEL_VERBOSE: return "verbose";
+                case LOG_LEVEL_NOTICE:  return "notice";
+                case LOG_LEVEL_WARNING: return "warning";
+                case LOG_LEVEL_ERROR:   return "error";
+                default:                return "";
+            }
+        }
+
+        int64_t steadyMillis(){
+            return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+        }
+    }
+
+    //--------------------------------------------------------------
+    void setLogHandler( LogHandler h ){
+        std::lock_guard<std::mutex> lock( handlerMutex() );
+        handler() = h;
+    }
+
+    //--------------------------------------------------------------
+    void setLogLevel( LogLevel level ){
+        logging::minLevel.store( (int) level, std::memory_order_relaxed );
+    }
+
+    //--------------------------------------------------------------
+    LogLevel getLogLevel(){
+        return (LogLevel) logging::minLevel.load( std::memory_order_relaxed );
+    }
+
+    namespace logging {
+
+        std::atomic<int> minLevel( LOG_LEVEL_NOTICE );
+
+        //--------------------------------------------------------------
+        bool CallSite::allow( int intervalMillis ){
+            if ( intervalMillis <= 0 ) return true;
+
+            int64_t now = steadyMillis();
+            int64_t next = nextMillis.load( std::memory_order_relaxed );
+            // only one of several racing threads wins the slot
+            if ( now >= next && nextMillis.compare_exchange_strong( next, now + intervalMillis, std::memory_order_relaxed ) ){
+                return true;
+            }
+            suppressed.fetch_add( 1, std::memory_order_relaxed );
+            return false;
+        }
+
+        //--------------------------------------------------------------
+        void write( LogLevel level, const std::string & message, uint32_t suppressed ){
+            std::string line = message;
+            if ( suppressed > 0 ){
+                line += " (" + std::to_string( (unsigned long long) suppressed ) + " similar suppressed)";
+            }
+
+            LogHandler h;
+            {
+                std::lock_guard<std::mutex> lock( handlerMutex() );
+                h = handler();
+            }
+
+            if ( h ){
+                h( level, line );
+            } else {
+                std::clog << "[Spacebrew] " << levelName( level ) << ": " << line << std::endl;
+            }
+        }
+    }
+}
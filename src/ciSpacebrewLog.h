@@ -0,0 +1,145 @@
+//
+//  ciSpacebrewLog.h
+//  ciSpacebrew
+//
+//  Leveled, rate-limited logging for the block. Everything the library reports goes through
+//  the SPACEBREW_LOG_* macros below and ends up in one replaceable handler.
+//
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <stdint.h>
+
+/**
+ * @brief Lowest level that is compiled in at all: 0 verbose, 1 notice, 2 warning, 3 error,
+ * 4 nothing. Statements below it expand to nothing, so they cost nothing on hot paths.
+ * @example
+ * // release builds: keep only errors
+ * -DSPACEBREW_LOG_MIN_LEVEL=3
+ */
+#ifndef SPACEBREW_LOG_MIN_LEVEL
+#define SPACEBREW_LOG_MIN_LEVEL 0
+#endif
+
+/**
+ * @brief Default minimum time between two lines from the same call site. Anything logged in
+ * between is counted and reported with the next line that gets through.
+ */
+#ifndef SPACEBREW_LOG_INTERVAL_MILLIS
+#define SPACEBREW_LOG_INTERVAL_MILLIS 1000
+#endif
+
+namespace Spacebrew {
+
+    // LOG_WARNING etc. are syslog macros on POSIX, hence the longer names
+    enum LogLevel {
+        LOG_LEVEL_VERBOSE = 0,
+        LOG_LEVEL_NOTICE,
+        LOG_LEVEL_WARNING,
+        LOG_LEVEL_ERROR,
+        LOG_LEVEL_SILENT
+    };
+
+    /**
+     * @brief Receives every line that passes the level and rate checks. Called on whichever
+     * thread logged it, possibly several at once.
+     */
+    typedef std::function<void( LogLevel level, const std::string & message )> LogHandler;
+
+    /**
+     * @brief Replace where log lines go (default: std::clog). Pass an empty handler to restore
+     * the default.
+     * @example
+     * Spacebrew::setLogHandler( []( Spacebrew::LogLevel level, const std::string & msg ){
+     *     if ( level >= Spacebrew::LOG_LEVEL_WARNING ) ci::app::console() << msg << std::endl;
+     * });
+     */
+    void setLogHandler( LogHandler handler );
+
+    /**
+     * @brief Runtime minimum level (default LOG_LEVEL_NOTICE). Lines below it are skipped
+     * before they are formatted.
+     */
+    void setLogLevel( LogLevel level );
+    LogLevel getLogLevel();
+
+    namespace logging {
+
+        extern std::atomic<int> minLevel;
+
+        inline bool isEnabled( LogLevel level ){
+            return (int) level >= minLevel.load( std::memory_order_relaxed );
+        }
+
+        /**
+         * @brief Rate limiter state for one SPACEBREW_LOG_EVERY call site. Constant initialized, so the
+         * function-local static costs no guard.
+         */
+        struct CallSite {
+            constexpr CallSite() : nextMillis( 0 ), suppressed( 0 ) {}
+
+            /**
+             * @return true if this call site may log now; otherwise counts the line as suppressed
+             */
+            bool allow( int intervalMillis );
+
+            /**
+             * @return Number of lines suppressed since the last one that got through, and reset it
+             */
+            uint32_t takeSuppressed(){
+                return suppressed.exchange( 0, std::memory_order_relaxed );
+            }
+
+            std::atomic<int64_t>    nextMillis;
+            std::atomic<uint32_t>   suppressed;
+        };
+
+        void write( LogLevel level, const std::string & message, uint32_t suppressed );
+    }
+}
+
+/**
+ * @brief Log `expr` (anything that can be streamed into an ostream) at `level`, at most once
+ * every `intervalMillis` from this call site. Nothing is formatted unless the line is written.
+ */
+#define SPACEBREW_LOG_EVERY( level, intervalMillis, expr ) \
+    do { \
+        if ( Spacebrew::logging::isEnabled( level ) ){ \
+            static Spacebrew::logging::CallSite spacebrewLogSite; \
+            if ( spacebrewLogSite.allow( intervalMillis ) ){ \
+                std::ostringstream spacebrewLogLine; \
+                spacebrewLogLine << expr; \
+                Spacebrew::logging::write( level, spacebrewLogLine.str(), spacebrewLogSite.takeSuppressed() ); \
+            } \
+        } \
+    } while ( 0 )
+
+#define SPACEBREW_LOG_NOOP() do {} while ( 0 )
+
+#if SPACEBREW_LOG_MIN_LEVEL <= 0
+#define SPACEBREW_LOG_VERBOSE( expr ) SPACEBREW_LOG_EVERY( Spacebrew::LOG_LEVEL_VERBOSE, SPACEBREW_LOG_INTERVAL_MILLIS, expr )
+#else
+#define SPACEBREW_LOG_VERBOSE( expr ) SPACEBREW_LOG_NOOP()
+#endif
+
+#if SPACEBREW_LOG_MIN_LEVEL <= 1
+#define SPACEBREW_LOG_NOTICE( expr ) SPACEBREW_LOG_EVERY( Spacebrew::LOG_LEVEL_NOTICE, SPACEBREW_LOG_INTERVAL_MILLIS, expr )
+#else
+#define SPACEBREW_LOG_NOTICE( expr ) SPACEBREW_LOG_NOOP()
+#endif
+
+#if SPACEBREW_LOG_MIN_LEVEL <= 2
+#define SPACEBREW_LOG_WARNING( expr ) SPACEBREW_LOG_EVERY( Spacebrew::LOG_LEVEL_WARNING, SPACEBREW_LOG_INTERVAL_MILLIS, expr )
+#else
+#define SPACEBREW_LOG_WARNING( expr ) SPACEBREW_LOG_NOOP()
+#endif
+
+#if SPACEBREW_LOG_MIN_LEVEL <= 3
+#define SPACEBREW_LOG_ERROR( expr ) SPACEBREW_LOG_EVERY( Spacebrew::LOG_LEVEL_ERROR, SPACEBREW_LOG_INTERVAL_MILLIS, expr )
+#else
+#define SPACEBREW_LOG_ERROR( expr ) SPACEBREW_LOG_NOOP()
+#endif
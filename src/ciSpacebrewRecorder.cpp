@@ -0,0 +1,387 @@
+//
+//  ciSpacebrewRecorder.cpp
+//  ciSpacebrew
+//
+
+#include "ciSpacebrewRecorder.h"
+#include "ciSpacebrew.h"
+
+#include <algorithm>
+
+#if defined( _WIN32 )
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Spacebrew {
+
+    namespace {
+
+        // file layout, all little endian:
+        //   LogHeader, then per frame a FrameHeader followed by the frame, padded to 8 bytes
+        const char      kMagic[ 8 ]     = { 'S', 'B', 'R', 'E', 'C', 0, 0, 1 };
+        const uint64_t  kMinGrowth      = 16 * 1024 * 1024;
+
+        struct LogHeader {
+            char        magic[ 8 ];
+            uint64_t    end;            // offset just past the last whole frame
+            uint64_t    numFrames;
+            uint64_t    reserved;
+        };
+
+        struct FrameHeader {
+            int64_t     timestamp;
+            uint32_t    length;
+            uint32_t    direction;
+        };
+
+        inline uint64_t padded( uint64_t n ){
+            return ( n + 7 ) & ~(uint64_t) 7;
+        }
+    }
+
+#pragma mark MappedFile
+
+    //--------------------------------------------------------------
+    MappedFile::MappedFile() : data_( NULL ), size_( 0 ) {
+#if defined( _WIN32 )
+        file    = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#else
+        file    = -1;
+#endif
+    }
+
+    //--------------------------------------------------------------
+    MappedFile::~MappedFile(){
+        close();
+    }
+
+#if defined( _WIN32 )
+
+    //--------------------------------------------------------------
+    bool MappedFile::create( const std::string & path, uint64_t size ){
+        close();
+        file = CreateFileA( path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+        if ( file == INVALID_HANDLE_VALUE ){
+            return false;
+        }
+        return resize( size );
+    }
+
+    //--------------------------------------------------------------
+    bool MappedFile::openRead( const std::string & path ){
+        close();
+        file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+        if ( file == INVALID_HANDLE_VALUE ){
+            return false;
+        }
+        LARGE_INTEGER size;
+        if ( !GetFileSizeEx( file, &size ) || size.QuadPart == 0 ){
+            close();
+            return false;
+        }
+        size_ = (uint64_t) size.QuadPart;
+        if ( !map( false ) ){
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------
+    bool MappedFile::resize( uint64_t size ){
+        unmap();
+        LARGE_INTEGER pos;
+        pos.QuadPart = (LONGLONG) size;
+        if ( !SetFilePointerEx( file, pos, NULL, FILE_BEGIN ) || !SetEndOfFile( file ) ){
+            return false;
+        }
+        size_ = size;
+        return size == 0 || map( true );
+    }
+
+    //--------------------------------------------------------------
+    bool MappedFile::map( bool bWrite ){
+        mapping = CreateFileMappingA( file, NULL, bWrite ? PAGE_READWRITE : PAGE_READONLY, (DWORD)( size_ >> 32 ), (DWORD) size_, NULL );
+        if ( mapping == NULL ){
+            return false;
+        }
+        data_ = (char *) MapViewOfFile( mapping, bWrite ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (SIZE_T) size_ );
+        return data_ != NULL;
+    }
+
+    //--------------------------------------------------------------
+    void MappedFile::unmap(){
+        if ( data_ ){
+            UnmapViewOfFile( data_ );
+            data_ = NULL;
+        }
+        if ( mapping ){
+            CloseHandle( mapping );
+            mapping = NULL;
+        }
+    }
+
+    //--------------------------------------------------------------
+    void MappedFile::close(){
+        unmap();
+        if ( file != INVALID_HANDLE_VALUE ){
+            CloseHandle( file );
+            file = INVALID_HANDLE_VALUE;
+        }
+        size_ = 0;
+    }
+
+#else
+
+    //--------------------------------------------------------------
+    bool MappedFile::create( const std::string & path, uint64_t size ){
+        close();
+        file = ::open( path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+        if ( file < 0 ){
+            return false;
+        }
+        return resize( size );
+    }
+
+    //--------------------------------------------------------------
+    bool MappedFile::openRead( const std::string & path ){
+        close();
+        file = ::open( path.c_str(), O_RDONLY );
+        if ( file < 0 ){
+            return false;
+        }
+        struct stat st;
+        if ( fstat( file, &st ) != 0 || st.st_size == 0 ){
+            close();
+            return false;
+        }
+        size_ = (uint64_t) st.st_size;
+        if ( !map( false ) ){
+            close();
+            return false;
+        }
+        // replay reads front to back
+        madvise( data_, size_, MADV_SEQUENTIAL );
+        return true;
+    }
+
+    //--------------------------------------------------------------
+    bool MappedFile::resize( uint64_t size ){
+        unmap();
+        if ( ftruncate( file, (off_t) size ) != 0 ){
+            return false;
+        }
+        size_ = size;
+        return size == 0 || map( true );
+    }
+
+    //--------------------------------------------------------------
+    bool MappedFile::map( bool bWrite ){
+        void * p = mmap( NULL, (size_t) size_, bWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0 );
+        if ( p == MAP_FAILED ){
+            return false;
+        }
+        data_ = (char *) p;
+        return true;
+    }
+
+    //--------------------------------------------------------------
+    void MappedFile::unmap(){
+        if ( data_ ){
+            munmap( data_, (size_t) size_ );
+            data_ = NULL;
+        }
+    }
+
+    //--------------------------------------------------------------
+    void MappedFile::close(){
+        unmap();
+        if ( file >= 0 ){
+            ::close( file );
+            file = -1;
+        }
+        size_ = 0;
+    }
+
+#endif
+
+#pragma mark Recorder
+
+    //--------------------------------------------------------------
+    Recorder::Recorder() : end( 0 ), numFrames( 0 ) {}
+
+    //--------------------------------------------------------------
+    Recorder::~Recorder(){
+        close();
+    }
+
+    //--------------------------------------------------------------
+    bool Recorder::open( const std::string & path ){
+        std::lock_guard<std::mutex> lock( mutex );
+        if ( !file.create( path, kMinGrowth ) ){
+            SPACEBREW_LOG_ERROR( "Spacebrew::Recorder couldn't create " << path );
+            file.close();
+            return false;
+        }
+        LogHeader * header = (LogHeader *) file.data();
+        memcpy( header->magic, kMagic, sizeof(kMagic) );
+        header->end         = sizeof(LogHeader);
+        header->numFrames   = 0;
+        header->reserved    = 0;
+        end         = sizeof(LogHeader);
+        numFrames   = 0;
+        return true;
+    }
+
+    //--------------------------------------------------------------
+    void Recorder::close(){
+        std::lock_guard<std::mutex> lock( mutex );
+        if ( file.isOpen() ){
+            file.resize( end );
+            file.close();
+        }
+    }
+
+    //--------------------------------------------------------------
+    void Recorder::record( RecordedFrame::Direction direction, const char * data, size_t len, int64_t timestamp ){
+        std::lock_guard<std::mutex> lock( mutex );
+        if ( !file.isOpen() ){
+            return;
+        }
+
+        uint64_t need = sizeof(FrameHeader) + padded( len );
+        if ( end + need > file.size() ){
+            // double, so remapping happens O(log n) times over a recording
+            if ( !file.resize( std::max( end + need, file.size() + std::max( file.size(), kMinGrowth ) ) ) ){
+                SPACEBREW_LOG_ERROR( "Spacebrew::Recorder couldn't grow the log, recording stopped" );
+                file.close();
+                return;
+            }
+        }
+
+        char * p = file.data() + end;
+        FrameHeader frame;
+        frame.timestamp = timestamp;
+        frame.length    = (uint32_t) len;
+        frame.direction = (uint32_t) direction;
+        memcpy( p, &frame, sizeof(frame) );
+        memcpy( p + sizeof(frame), data, len );
+
+        end += need;
+        numFrames++;
+
+        LogHeader * header = (LogHeader *) file.data();
+        header->numFrames   = numFrames;
+        header->end         = end;
+    }
+
+#pragma mark Replayer
+
+    //--------------------------------------------------------------
+    Replayer::Replayer() : cursor( 0 ), end( 0 ), bStarted( false ), bHasPending( false ), speed( 1 ), startTime( 0 ), firstTimestamp( 0 ) {}
+
+    //--------------------------------------------------------------
+    bool Replayer::open( const std::string & path ){
+        close();
+        if ( !file.openRead( path ) || file.size() < sizeof(LogHeader) || memcmp( file.data(), kMagic, sizeof(kMagic) ) != 0 ){
+            SPACEBREW_LOG_ERROR( "Spacebrew::Replayer couldn't read " << path );
+            file.close();
+            return false;
+        }
+        const LogHeader * header = (const LogHeader *) file.data();
+        end = std::min( header->end, file.size() );
+        rewind();
+        return true;
+    }
+
+    //--------------------------------------------------------------
+    void Replayer::close(){
+        file.close();
+        cursor      = 0;
+        end         = 0;
+        bStarted    = false;
+        bHasPending = false;
+    }
+
+    //--------------------------------------------------------------
+    void Replayer::rewind(){
+        cursor      = sizeof(LogHeader);
+        bHasPending = false;
+    }
+
+    //--------------------------------------------------------------
+    bool Replayer::next( RecordedFrame & out ){
+        if ( !file.isOpen() || cursor + sizeof(FrameHeader) > end ){
+            return false;
+        }
+        FrameHeader frame;
+        memcpy( &frame, file.data() + cursor, sizeof(frame) );
+        if ( cursor + sizeof(FrameHeader) + frame.length > end ){
+            return false;
+        }
+
+        out.direction   = frame.direction == RecordedFrame::DIRECTION_OUTBOUND ? RecordedFrame::DIRECTION_OUTBOUND : RecordedFrame::DIRECTION_INBOUND;
+        out.timestamp   = frame.timestamp;
+        out.data        = StringRef( file.data() + cursor + sizeof(FrameHeader), frame.length );
+        cursor += sizeof(FrameHeader) + padded( frame.length );
+        return true;
+    }
+
+    //--------------------------------------------------------------
+    void Replayer::start( double _speed ){
+        rewind();
+        speed       = _speed > 0 ? _speed : 0;
+        bStarted    = true;
+        startTime   = nanoTime();
+
+        // timing is relative to the first frame
+        firstTimestamp = 0;
+        if ( peek() ){
+            firstTimestamp = pending.timestamp;
+        }
+    }
+
+    //--------------------------------------------------------------
+    bool Replayer::peek(){
+        while ( !bHasPending && next( pending ) ){
+            bHasPending = pending.direction == RecordedFrame::DIRECTION_INBOUND;
+        }
+        return bHasPending;
+    }
+
+    //--------------------------------------------------------------
+    size_t Replayer::update( Connection & connection, size_t maxFrames ){
+        if ( connection.isThreaded() ){
+            SPACEBREW_LOG_ERROR( "Spacebrew::Replayer can't feed a threaded Connection" );
+            return 0;
+        }
+        if ( !bStarted ){
+            start( speed );
+        }
+
+        double elapsed = ( nanoTime() - startTime ) * speed;
+        size_t count = 0;
+        while ( count < maxFrames && peek() ){
+            if ( speed > 0 && pending.timestamp - firstTimestamp > elapsed ){
+                break;
+            }
+            bHasPending = false;
+            frameBuffer.assign( pending.data.data, pending.data.size );
+            connection.receiveFrame( frameBuffer );
+            count++;
+        }
+        return count;
+    }
+}
@@ -0,0 +1,188 @@
+//
+//  ciSpacebrewRecorder.h
+//  ciSpacebrew
+//
+//  Record a Connection's traffic to a memory-mapped log and play it back into a Connection,
+//  for reproducing field problems and load testing handlers without a server.
+//
+
+#pragma once
+
+#include "ciSpacebrewJson.h"
+
+#include <mutex>
+#include <string>
+#include <stdint.h>
+
+namespace Spacebrew {
+
+    class Connection;
+
+    /**
+     * @brief One frame of a recording
+     */
+    struct RecordedFrame {
+        enum Direction {
+            DIRECTION_INBOUND   = 0,    // received (Connection::onRead)
+            DIRECTION_OUTBOUND  = 1     // sent (every frame Connection writes)
+        };
+
+        RecordedFrame() : direction( DIRECTION_INBOUND ), timestamp( 0 ) {}
+
+        Direction   direction;
+        int64_t     timestamp;  // nanoTime() when recorded
+        StringRef   data;       // points into the mapped log
+    };
+
+    /**
+     * @brief A file mapped into memory, read only or growable read/write. POSIX mmap or Win32 file
+     * mappings underneath.
+     * @class Spacebrew::MappedFile
+     */
+    class MappedFile {
+      public:
+        MappedFile();
+        ~MappedFile();
+
+        /**
+         * @brief Create (or truncate) path and map size bytes of it read/write
+         */
+        bool create( const std::string & path, uint64_t size );
+
+        /**
+         * @brief Map all of an existing file read only
+         */
+        bool openRead( const std::string & path );
+
+        /**
+         * @brief Grow or shrink a file opened with create() and map it again. data() moves.
+         */
+        bool resize( uint64_t size );
+
+        void close();
+
+        bool        isOpen() const { return data_ != NULL; }
+        char *      data() const { return data_; }
+        uint64_t    size() const { return size_; }
+
+      protected:
+        bool map( bool bWrite );
+        void unmap();
+
+#if defined( _WIN32 )
+        void *      file;
+        void *      mapping;
+#else
+        int         file;
+#endif
+        char *      data_;
+        uint64_t    size_;
+
+      private:
+        MappedFile( const MappedFile & );
+        MappedFile & operator=( const MappedFile & );
+    };
+
+    /**
+     * @brief Appends timestamped frames to a binary log. The file is mapped and grown in large
+     * steps, so recording a frame is a memcpy; the header's end offset is updated after every
+     * frame, so a log cut short by a crash is still readable up to the last whole frame.
+     * Safe to record from the socket thread and the app thread at once.
+     * @example
+     * Spacebrew::Recorder recorder;
+     * recorder.open( ( getDocumentsDirectory() / "session.sbrec" ).string() );
+     * connection.setRecorder( &recorder );
+     * @class Spacebrew::Recorder
+     */
+    class Recorder {
+      public:
+        Recorder();
+        ~Recorder();
+
+        /**
+         * @brief Start a new log at path (an existing file is overwritten)
+         */
+        bool open( const std::string & path );
+
+        /**
+         * @brief Trim the file to what was recorded and unmap it
+         */
+        void close();
+
+        bool isOpen() const { return file.isOpen(); }
+
+        void record( RecordedFrame::Direction direction, const char * data, size_t len, int64_t timestamp );
+
+        uint64_t getNumFrames() const { return numFrames; }
+        uint64_t getNumBytes() const { return end; }
+
+      protected:
+        MappedFile  file;
+        std::mutex  mutex;
+        uint64_t    end;
+        uint64_t    numFrames;
+    };
+
+    /**
+     * @brief Reads a log written by Recorder straight from the mapped file (no copy, so logs larger
+     * than memory can be scanned; multi-GB logs need a 64-bit build) and feeds its inbound frames
+     * back through a Connection's receive path: parsing, latest values, dispatch budget and
+     * signals, exactly as if they had come off the socket.
+     *
+     * Replay into a Connection that isn't connected or threaded, from the thread that calls its update().
+     * @example
+     * Spacebrew::Replayer replayer;
+     * replayer.open( "session.sbrec" );
+     * replayer.start( 4.0 );     // 4x speed
+     * // every frame
+     * replayer.update( connection );
+     * connection.update();
+     * @class Spacebrew::Replayer
+     */
+    class Replayer {
+      public:
+        Replayer();
+
+        bool open( const std::string & path );
+        void close();
+        bool isOpen() const { return file.isOpen(); }
+
+        /**
+         * @brief Sequential access to every frame (both directions)
+         * @return false at the end of the log
+         */
+        bool next( RecordedFrame & frame );
+        void rewind();
+
+        /**
+         * @brief Start (or restart) a timed replay from the beginning
+         * @param {double} speed    1 for the original timing, N for N times faster, 0 for as fast as possible
+         */
+        void start( double speed = 1.0 );
+
+        /**
+         * @brief Feed the inbound frames that are due into connection (all remaining ones at speed 0),
+         * at most maxFrames of them; the rest follow on the next calls
+         * @return Number of frames fed (0 for a threaded Connection, whose receive path belongs to its socket thread)
+         */
+        size_t update( Connection & connection, size_t maxFrames = 1024 );
+
+        bool isDone() const { return bStarted && !bHasPending && cursor >= end; }
+
+      protected:
+        bool peek();
+
+        MappedFile      file;
+        uint64_t        cursor;
+        uint64_t        end;
+
+        // timed replay
+        bool            bStarted;
+        bool            bHasPending;
+        RecordedFrame   pending;
+        std::string     frameBuffer;    // handed to the Connection, recycles its read buffer
+        double          speed;
+        int64_t         startTime;
+        int64_t         firstTimestamp;
+    };
+}
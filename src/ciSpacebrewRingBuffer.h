@@ -0,0 +1,94 @@
+//
+//  ciSpacebrewRingBuffer.h
+//  ciSpacebrew
+//
+//  Bounded single-producer / single-consumer queue used to hand messages between
+//  the network thread and the app thread.
+//
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+namespace Spacebrew {
+
+    /**
+     * @brief Lock-free SPSC ring. Items are swapped in and out rather than copied, so
+     * strings and other heap-backed members keep cycling the same buffers between the
+     * producer and consumer once the ring is warm.
+     * @class Spacebrew::RingBuffer
+     */
+    template<typename T>
+    class RingBuffer {
+      public:
+
+        /** @constructor capacity is rounded up to a power of two */
+        explicit RingBuffer( size_t capacity = 1024 ){
+            resize( capacity );
+        }
+
+        /**
+         * @brief Not thread safe, only call while neither side is using the ring
+         */
+        void resize( size_t capacity ){
+            size_t n = 2;
+            while ( n < capacity ) n <<= 1;
+            slots.clear();
+            slots.resize( n );
+            mask = n - 1;
+            head.store( 0, std::memory_order_relaxed );
+            tail.store( 0, std::memory_order_relaxed );
+        }
+
+        /**
+         * @brief Producer side. On success item is left holding whatever was in the slot before.
+         * @return false if the ring is full
+         */
+        bool push( T & item ){
+            size_t t = tail.load( std::memory_order_relaxed );
+            if ( t - head.load( std::memory_order_acquire ) > mask ){
+                return false;
+            }
+            std::swap( slots[ t & mask ], item );
+            tail.store( t + 1, std::memory_order_release );
+            return true;
+        }
+
+        /**
+         * @brief Consumer side
+         * @return false if the ring is empty
+         */
+        bool pop( T & item ){
+            size_t h = head.load( std::memory_order_relaxed );
+            if ( h == tail.load( std::memory_order_acquire ) ){
+                return false;
+            }
+            std::swap( item, slots[ h & mask ] );
+            head.store( h + 1, std::memory_order_release );
+            return true;
+        }
+
+        /**
+         * @return Approximate number of queued items (exact from either the producer or consumer thread)
+         */
+        size_t size() const {
+            return tail.load( std::memory_order_acquire ) - head.load( std::memory_order_acquire );
+        }
+
+        size_t capacity() const { return mask + 1; }
+        bool   empty() const { return size() == 0; }
+
+      protected:
+        std::vector<T>      slots;
+        size_t              mask;
+
+        // keep the two indices on separate cache lines
+        char                pad0[ 64 ];
+        std::atomic<size_t> head;
+        char                pad1[ 64 ];
+        std::atomic<size_t> tail;
+        char                pad2[ 64 ];
+    };
+}
@@ -0,0 +1,188 @@
+//
+//  ciSpacebrewStateCache.cpp
+//  ciSpacebrew
+//
+
+#include "ciSpacebrewStateCache.h"
+
+#include <algorithm>
+
+namespace Spacebrew {
+
+    namespace {
+
+        inline uint64_t doubleBits( double d ){
+            uint64_t u;
+            memcpy( &u, &d, sizeof(u) );
+            return u;
+        }
+
+        inline double bitsDouble( uint64_t u ){
+            double d;
+            memcpy( &d, &u, sizeof(d) );
+            return d;
+        }
+    }
+
+#pragma mark LatestValue
+
+    //--------------------------------------------------------------
+    LatestValue::LatestValue( const std::string & _name, const std::string & _type, size_t _capacity ) :
+        name( _name ), type( _type ), capacity( _capacity ), sequence( 0 ), number( doubleBits( 0 ) )
+    {
+        for ( size_t i = 0; i < kVersions; i++ ){
+            versions[i].sequence.store( 0, std::memory_order_relaxed );
+            versions[i].size.store( 0, std::memory_order_relaxed );
+            versions[i].data.reset( new char[ capacity > 0 ? capacity : 1 ] );
+        }
+    }
+
+    //--------------------------------------------------------------
+    void LatestValue::set( const StringRef & value ){
+        uint64_t next = sequence.load( std::memory_order_relaxed ) + 1;
+
+        // seqlock on the buffer we're about to overwrite: the one read kVersions - 1 values ago
+        Version & v = versions[ next % kVersions ];
+        v.sequence.store( 0, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+
+        size_t len = std::min( value.size, capacity );
+        memcpy( v.data.get(), value.data, len );
+        v.size.store( (uint32_t) len, std::memory_order_relaxed );
+        v.sequence.store( next, std::memory_order_release );
+
+        double d = 0;
+        if ( !parseNumber( value, d ) ){
+            d = value == StringRef( "true", 4 ) ? 1 : 0;
+        }
+        number.store( doubleBits( d ), std::memory_order_relaxed );
+
+        sequence.store( next, std::memory_order_release );
+    }
+
+    //--------------------------------------------------------------
+    double LatestValue::getDouble() const {
+        return bitsDouble( number.load( std::memory_order_relaxed ) );
+    }
+
+    //--------------------------------------------------------------
+    int LatestValue::getRange() const {
+        double d = getDouble();
+        return d < 0 ? 0 : d > 1023 ? 1023 : (int) d;
+    }
+
+    //--------------------------------------------------------------
+    uint64_t LatestValue::getString( std::string & out ) const {
+        for ( ;; ){
+            uint64_t s = sequence.load( std::memory_order_acquire );
+            if ( s == 0 ){
+                out.clear();
+                return 0;
+            }
+
+            const Version & v = versions[ s % kVersions ];
+            if ( v.sequence.load( std::memory_order_acquire ) != s ){
+                continue;   // the writer already lapped this buffer
+            }
+            out.assign( v.data.get(), v.size.load( std::memory_order_relaxed ) );
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if ( v.sequence.load( std::memory_order_relaxed ) == s ){
+                return s;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------
+    std::string LatestValue::getString() const {
+        std::string out;
+        getString( out );
+        return out;
+    }
+
+#pragma mark StateCache
+
+    //--------------------------------------------------------------
+    StateCache::Table::Table( size_t capacity ) : mask( capacity - 1 ), slots( new std::atomic<LatestValue *>[ capacity ] ) {
+        for ( size_t i = 0; i < capacity; i++ ){
+            slots[i].store( NULL, std::memory_order_relaxed );
+        }
+    }
+
+    //--------------------------------------------------------------
+    StateCache::StateCache( size_t _stringCapacity ) : count( 0 ), stringCapacity( _stringCapacity ) {
+        tables.push_back( std::unique_ptr<Table>( new Table( 16 ) ) );
+        table.store( tables.back().get(), std::memory_order_release );
+    }
+
+    //--------------------------------------------------------------
+    LatestValue * StateCache::add( const std::string & name, const std::string & type ){
+        std::lock_guard<std::mutex> lock( mutex );
+
+        Table * t = table.load( std::memory_order_relaxed );
+        LatestValue * existing = lookup( *t, StringRef( name ) );
+        if ( existing ){
+            return existing;
+        }
+
+        // keep the load factor under a half so probes stay short
+        if ( ( values.size() + 1 ) * 2 > t->mask + 1 ){
+            tables.push_back( std::unique_ptr<Table>( new Table( ( t->mask + 1 ) * 2 ) ) );
+            t = tables.back().get();
+            for ( size_t i = 0; i < values.size(); i++ ){
+                insert( *t, values[i].get() );
+            }
+            table.store( t, std::memory_order_release );
+        }
+
+        values.push_back( std::unique_ptr<LatestValue>( new LatestValue( name, type, stringCapacity ) ) );
+        insert( *t, values.back().get() );
+        count.store( values.size(), std::memory_order_release );
+        return values.back().get();
+    }
+
+    //--------------------------------------------------------------
+    const LatestValue * StateCache::find( const StringRef & name ) const {
+        return lookup( *table.load( std::memory_order_acquire ), name );
+    }
+
+    //--------------------------------------------------------------
+    void StateCache::set( const StringRef & name, const StringRef & value ){
+        LatestValue * v = lookup( *table.load( std::memory_order_acquire ), name );
+        if ( v ){
+            v->set( value );
+        }
+    }
+
+    //--------------------------------------------------------------
+    LatestValue * StateCache::lookup( const Table & t, const StringRef & name ) const {
+        for ( size_t i = hash( name ) & t.mask; ; i = ( i + 1 ) & t.mask ){
+            LatestValue * v = t.slots[i].load( std::memory_order_acquire );
+            if ( v == NULL ){
+                return NULL;
+            }
+            if ( StringRef( v->name ) == name ){
+                return v;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------
+    void StateCache::insert( Table & t, LatestValue * value ){
+        size_t i = hash( StringRef( value->name ) ) & t.mask;
+        while ( t.slots[i].load( std::memory_order_relaxed ) != NULL ){
+            i = ( i + 1 ) & t.mask;
+        }
+        t.slots[i].store( value, std::memory_order_release );
+    }
+
+    //--------------------------------------------------------------
+    size_t StateCache::hash( const StringRef & s ){
+        // FNV-1a
+        uint64_t h = 14695981039346656037ULL;
+        for ( size_t i = 0; i < s.size; i++ ){
+            h ^= (unsigned char) s.data[i];
+            h *= 1099511628211ULL;
+        }
+        return (size_t) h;
+    }
+}
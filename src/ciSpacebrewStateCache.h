@@ -0,0 +1,156 @@
+//
+//  ciSpacebrewStateCache.h
+//  ciSpacebrew
+//
+//  Latest value of every subscription, for code that samples state (draw(), worker threads)
+//  instead of reacting to each message.
+//
+
+#pragma once
+
+#include "ciSpacebrewJson.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace Spacebrew {
+
+    /**
+     * @brief Latest value received on one subscription. Written by the thread that reads the
+     * socket, read from any thread: numeric reads and sequence checks are single atomic loads;
+     * getString copies out of one of a few versioned buffers and only retries if the writer
+     * cycled through all of them during the copy.
+     *
+     * Get one from Connection::getLatest once and keep the pointer; it stays valid for the
+     * Connection's lifetime.
+     * @example
+     * const Spacebrew::LatestValue * bg = connection.getLatest( "backgroundColor" );
+     * // in draw()
+     * gl::clear( Color::gray( bg->getRange() / 1023.0f ) );
+     * @class Spacebrew::LatestValue
+     */
+    class LatestValue {
+      public:
+        const std::string & getName() const { return name; }
+        const std::string & getType() const { return type; }
+
+        /**
+         * @return Number of values received so far (0: nothing yet). Compare with an earlier
+         * read to see if the value changed.
+         */
+        uint64_t getSequence() const { return sequence.load( std::memory_order_acquire ); }
+
+        /**
+         * @return true if a value newer than lastSequence arrived, and update lastSequence
+         */
+        bool hasChanged( uint64_t & lastSequence ) const {
+            uint64_t s = getSequence();
+            if ( s == lastSequence ) return false;
+            lastSequence = s;
+            return true;
+        }
+
+        /**
+         * @brief Numeric value (ranges, numbers, booleans as 0/1), 0 for values that aren't numeric
+         */
+        double  getDouble() const;
+        int     getRange() const;
+        bool    getBoolean() const { return getDouble() != 0; }
+
+        /**
+         * @brief Copy the value's text (string contents, or raw JSON for other types) into out,
+         * reusing its capacity. Values longer than the cache's string capacity are cut off.
+         * @return Sequence number of the value copied
+         */
+        uint64_t getString( std::string & out ) const;
+        std::string getString() const;
+
+      protected:
+        friend class StateCache;
+
+        static const size_t kVersions = 4;
+
+        struct Version {
+            std::atomic<uint64_t>   sequence;   // value this buffer holds, 0 while being written
+            std::atomic<uint32_t>   size;
+            std::unique_ptr<char[]> data;
+        };
+
+        LatestValue( const std::string & _name, const std::string & _type, size_t _capacity );
+
+        void set( const StringRef & value );
+
+        std::string             name;
+        std::string             type;
+        size_t                  capacity;
+        std::atomic<uint64_t>   sequence;
+        std::atomic<uint64_t>   number;     // bits of a double
+        Version                 versions[ kVersions ];
+
+      private:
+        LatestValue( const LatestValue & );
+        LatestValue & operator=( const LatestValue & );
+    };
+
+    /**
+     * @brief Table of LatestValues, one per subscription name: an open addressed hash table of
+     * atomic pointers, so lookups from any thread take no lock. Entries are never removed or moved;
+     * growing publishes a bigger table and keeps the old one for readers still probing it.
+     * @class Spacebrew::StateCache
+     */
+    class StateCache {
+      public:
+        explicit StateCache( size_t stringCapacity = 512 );
+
+        /**
+         * @brief Add a subscription (no-op if the name is already there). Takes a lock, call rarely.
+         */
+        LatestValue * add( const std::string & name, const std::string & type );
+
+        /**
+         * @return The subscription's latest value, or NULL if it isn't in the cache. Lock free.
+         */
+        const LatestValue * find( const StringRef & name ) const;
+
+        /**
+         * @brief Record a received value for a subscription in the cache (others are ignored).
+         * Only one thread may call this (the one reading the socket).
+         */
+        void set( const StringRef & name, const StringRef & value );
+
+        size_t  size() const { return count.load( std::memory_order_acquire ); }
+
+        /**
+         * @brief Longest string value kept, in bytes. Only applies to subscriptions added afterwards.
+         */
+        void    setStringCapacity( size_t bytes ){ stringCapacity = bytes; }
+
+      protected:
+        struct Table {
+            explicit Table( size_t capacity );
+
+            size_t                                          mask;
+            std::unique_ptr< std::atomic<LatestValue *>[] > slots;
+        };
+
+        LatestValue * lookup( const Table & table, const StringRef & name ) const;
+        void          insert( Table & table, LatestValue * value );
+
+        static size_t hash( const StringRef & s );
+
+        std::atomic<Table *>                        table;
+        std::vector< std::unique_ptr<Table> >       tables;     // every table ever published; old ones may still be read
+        std::vector< std::unique_ptr<LatestValue> > values;
+        std::atomic<size_t>                         count;
+        std::mutex                                  mutex;      // add() only
+        size_t                                      stringCapacity;
+
+      private:
+        StateCache( const StateCache & );
+        StateCache & operator=( const StateCache & );
+    };
+}
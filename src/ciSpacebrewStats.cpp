@@ -0,0 +1,130 @@
+//
+//  ciSpacebrewStats.cpp
+//  ciSpacebrew
+//
+
+#include "ciSpacebrewStats.h"
+
+#include <algorithm>
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+namespace Spacebrew {
+    
+    namespace {
+        
+        inline int highestBit( uint64_t v ){
+#if defined( _MSC_VER )
+            unsigned long index;
+            _BitScanReverse64( &index, v );
+            return (int) index;
+#else
+            return 63 - __builtin_clzll( v );
+#endif
+        }
+    }
+    
+#pragma mark LatencyHistogram
+    
+    //--------------------------------------------------------------
+    LatencyHistogram::LatencyHistogram(){
+        reset();
+    }
+    
+    //--------------------------------------------------------------
+    void LatencyHistogram::reset(){
+        for ( int i = 0; i < kNumBuckets; i++ ){
+            buckets[i].store( 0, std::memory_order_relaxed );
+        }
+        count.store( 0, std::memory_order_relaxed );
+        sum.store( 0, std::memory_order_relaxed );
+        max.store( 0, std::memory_order_relaxed );
+    }
+    
+    //--------------------------------------------------------------
+    int LatencyHistogram::bucketFor( uint64_t v ){
+        const uint64_t kSub = 1 << kSubBucketBits;
+        if ( v < kSub ){
+            return (int) v;
+        }
+        int msb     = highestBit( v );
+        int shift   = msb - kSubBucketBits;
+        int sub     = (int)( ( v >> shift ) & ( kSub - 1 ) );
+        return ( ( msb - kSubBucketBits + 1 ) << kSubBucketBits ) + sub;
+    }
+    
+    //--------------------------------------------------------------
+    uint64_t LatencyHistogram::bucketValue( int bucket ){
+        const uint64_t kSub = 1 << kSubBucketBits;
+        if ( bucket < (int) kSub ){
+            return bucket;
+        }
+        int shift       = ( bucket >> kSubBucketBits ) - 1;
+        uint64_t lower  = ( kSub + ( bucket & ( kSub - 1 ) ) ) << shift;
+        
+        // middle of the bucket
+        return lower + ( ( uint64_t( 1 ) << shift ) >> 1 );
+    }
+    
+    //--------------------------------------------------------------
+    void LatencyHistogram::record( int64_t nanos ){
+        uint64_t v = nanos > 0 ? (uint64_t) nanos : 0;
+        buckets[ bucketFor( v ) ].fetch_add( 1, std::memory_order_relaxed );
+        count.fetch_add( 1, std::memory_order_relaxed );
+        sum.fetch_add( v, std::memory_order_relaxed );
+        
+        uint64_t prev = max.load( std::memory_order_relaxed );
+        while ( v > prev && !max.compare_exchange_weak( prev, v, std::memory_order_relaxed ) ){}
+    }
+    
+    //--------------------------------------------------------------
+    LatencyStats LatencyHistogram::snapshot() const {
+        LatencyStats s;
+        
+        // copy first, recording may carry on while we look
+        uint64_t counts[ kNumBuckets ];
+        uint64_t total = 0;
+        for ( int i = 0; i < kNumBuckets; i++ ){
+            counts[i] = buckets[i].load( std::memory_order_relaxed );
+            total += counts[i];
+        }
+        if ( total == 0 ){
+            return s;
+        }
+        
+        s.count = total;
+        s.mean  = (double) sum.load( std::memory_order_relaxed ) / count.load( std::memory_order_relaxed ) / 1000.0;
+        s.max   = max.load( std::memory_order_relaxed ) / 1000.0;
+        
+        const double    quantiles[]     = { 0.5, 0.9, 0.99 };
+        double *        results[]       = { &s.p50, &s.p90, &s.p99 };
+        uint64_t        seen            = 0;
+        int             q               = 0;
+        
+        for ( int i = 0; i < kNumBuckets && q < 3; i++ ){
+            seen += counts[i];
+            while ( q < 3 && seen >= (uint64_t)( quantiles[q] * total + 0.5 ) && seen > 0 ){
+                *results[q] = std::min( bucketValue( i ) / 1000.0, s.max );
+                q++;
+            }
+        }
+        return s;
+    }
+    
+#pragma mark Instrumentation
+    
+    //--------------------------------------------------------------
+    Instrumentation::Instrumentation(){
+        messagesIn              = 0;
+        messagesOut             = 0;
+        bytesIn                 = 0;
+        bytesOut                = 0;
+        maxInboundQueueDepth    = 0;
+        maxOutboundQueueDepth   = 0;
+        lastSnapshotTime        = nanoTime();
+        lastBytesIn             = 0;
+        lastBytesOut            = 0;
+    }
+}
@@ -0,0 +1,139 @@
+//
+//  ciSpacebrewStats.h
+//  ciSpacebrew
+//
+//  Optional latency / throughput instrumentation for Spacebrew::Connection.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <cstddef>
+
+namespace Spacebrew {
+
+    /**
+     * @return Monotonic clock in nanoseconds, used for every instrumentation timestamp
+     */
+    inline int64_t nanoTime(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    /**
+     * @brief Snapshot of a LatencyHistogram, in microseconds
+     */
+    struct LatencyStats {
+        LatencyStats() : count( 0 ), mean( 0 ), p50( 0 ), p90( 0 ), p99( 0 ), max( 0 ) {}
+
+        uint64_t    count;
+        double      mean;
+        double      p50;
+        double      p90;
+        double      p99;
+        double      max;
+    };
+
+    /**
+     * @brief Log-linear (HDR style) histogram of nanosecond durations: 8 buckets per power of two, so
+     * any recorded value is off by at most ~12%. Recording is a couple of relaxed atomic adds and is
+     * safe from any thread.
+     * @class Spacebrew::LatencyHistogram
+     */
+    class LatencyHistogram {
+      public:
+        LatencyHistogram();
+
+        void            record( int64_t nanos );
+        void            reset();
+        LatencyStats    snapshot() const;
+
+        static const int kSubBucketBits = 3;
+        static const int kNumBuckets    = 64 << kSubBucketBits;
+
+      protected:
+        static int      bucketFor( uint64_t nanos );
+        static uint64_t bucketValue( int bucket );
+
+        std::atomic<uint64_t>   buckets[ kNumBuckets ];
+        std::atomic<uint64_t>   count;
+        std::atomic<uint64_t>   sum;
+        std::atomic<uint64_t>   max;
+    };
+
+    /**
+     * @brief Everything Connection::getStats() reports
+     */
+    struct Stats {
+        Stats() : messagesIn( 0 ), messagesOut( 0 ), bytesIn( 0 ), bytesOut( 0 ), bytesInPerSecond( 0 ), bytesOutPerSecond( 0 ),
+                  inboundQueueDepth( 0 ), outboundQueueDepth( 0 ), maxInboundQueueDepth( 0 ), maxOutboundQueueDepth( 0 ),
+                  numCoalescedSends( 0 ), numDroppedWrites( 0 ), numDroppedReads( 0 ), numRateDropped( 0 ), numRateDelayed( 0 ),
+                  carryOverDepth( 0 ), maxCarryOverDepth( 0 ), numCollapsed( 0 ), numUnroutedSuppressed( 0 ) {}
+
+        // send() called -> frame handed to the socket (queueing, coalescing, socket thread hand-off)
+        LatencyStats    sendToWrite;
+
+        // frame arrived from the socket -> handlers start running (parsing, socket thread hand-off)
+        LatencyStats    receiveToDispatch;
+
+        // time spent in the message handlers
+        LatencyStats    dispatch;
+
+        uint64_t        messagesIn;
+        uint64_t        messagesOut;
+        uint64_t        bytesIn;
+        uint64_t        bytesOut;
+
+        // averaged since the previous getStats() call
+        double          bytesInPerSecond;
+        double          bytesOutPerSecond;
+
+        size_t          inboundQueueDepth;
+        size_t          outboundQueueDepth;
+        size_t          maxInboundQueueDepth;
+        size_t          maxOutboundQueueDepth;
+
+        size_t          numCoalescedSends;
+        size_t          numDroppedWrites;
+        size_t          numDroppedReads;
+        size_t          numRateDropped;
+        size_t          numRateDelayed;
+
+        // inbound messages held back by the dispatch budget (see Connection::setDispatchBudget)
+        size_t          carryOverDepth;
+        size_t          maxCarryOverDepth;
+        size_t          numCollapsed;
+
+        // sends skipped because nobody was routed to the publisher (see Connection::setSuppressUnrouted)
+        size_t          numUnroutedSuppressed;
+    };
+
+    /**
+     * @brief The counters behind Stats. Allocated by Connection only once instrumentation is turned on.
+     */
+    struct Instrumentation {
+        Instrumentation();
+
+        inline void queueDepth( std::atomic<size_t> & maxDepth, size_t depth ){
+            size_t prev = maxDepth.load( std::memory_order_relaxed );
+            while ( depth > prev && !maxDepth.compare_exchange_weak( prev, depth, std::memory_order_relaxed ) ){}
+        }
+
+        LatencyHistogram        sendToWrite;
+        LatencyHistogram        receiveToDispatch;
+        LatencyHistogram        dispatch;
+
+        std::atomic<uint64_t>   messagesIn;
+        std::atomic<uint64_t>   messagesOut;
+        std::atomic<uint64_t>   bytesIn;
+        std::atomic<uint64_t>   bytesOut;
+        std::atomic<size_t>     maxInboundQueueDepth;
+        std::atomic<size_t>     maxOutboundQueueDepth;
+
+        // for the per-second rates
+        int64_t                 lastSnapshotTime;
+        uint64_t                lastBytesIn;
+        uint64_t                lastBytesOut;
+    };
+}